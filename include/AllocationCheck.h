@@ -0,0 +1,73 @@
+#pragma once
+
+#include <iostream>
+#include "ErrorCounter.h"
+
+/**
+ * @brief Number of heap allocations made by this plugin on the calling thread.
+ *
+ * Counted only when the plugin is built with RTC_ALLOCATION_CHECK
+ * (make ALLOCATION_CHECK=1), otherwise always 0.
+ */
+unsigned long allocationCount();
+
+/**
+ * @brief Test hook which asserts that a hot path makes no heap allocation.
+ *
+ * begin() and end() bracket the work of one tick. After the warm-up ticks
+ * every tick which allocated is counted as a violation and reported through
+ * an ErrorCounter. Without RTC_ALLOCATION_CHECK both calls do nothing.
+ */
+class AllocationCheck {
+ private:
+  const char* m_name;
+  unsigned long m_warmup;
+  unsigned long m_ticks;
+  unsigned long m_start;
+  bool m_armed;
+  ErrorCounter m_violation;
+  static unsigned long s_totalViolations;
+
+ public:
+ AllocationCheck(const char* name, const unsigned long warmup=10) : m_name(name), m_warmup(warmup), m_ticks(0), m_start(0), m_armed(false) {}
+  ~AllocationCheck() {}
+
+ public:
+  void begin() {
+#ifdef RTC_ALLOCATION_CHECK
+    m_start = allocationCount();
+    m_armed = true;
+#endif
+  }
+
+  void end(const double time) {
+#ifdef RTC_ALLOCATION_CHECK
+    if (!m_armed) {
+      return;
+    }
+    m_armed = false;
+    unsigned long n = allocationCount() - m_start;
+    if (++m_ticks > m_warmup && n > 0) {
+      s_totalViolations++;
+      if (m_violation.raise(time)) {
+	std::cerr << " - AllocationCheck(" << m_name << "): " << n << " heap allocations in one tick ("
+		  << m_violation.take() << " ticks allocated since the last report)." << std::endl;
+      }
+    }
+#endif
+  }
+
+  void reset() {
+    m_ticks = 0;
+    m_armed = false;
+    m_violation.reset();
+  }
+
+  unsigned long violations() const { return m_violation.total(); }
+
+  /**
+   * Violations of all checks of the process, for test drivers which do
+   * not see the components' checks.
+   */
+  static unsigned long totalViolations() { return s_totalViolations; }
+};
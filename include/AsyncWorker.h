@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <coil/Task.h>
+#include <coil/Mutex.h>
+#include <coil/Condition.h>
+#include "Tasks.h"
+
+/**
+ * @brief Worker thread which processes jobs from a bounded queue.
+ *
+ * The job slots are allocated in start() and reused. The producer takes a
+ * slot with acquire(), fills it and hands it over with submit(). When every
+ * slot is queued or in process, acquire() takes back the oldest queued job
+ * (counted as dropped), so the producer never waits for the worker.
+ * Neither acquire() nor submit() allocates.
+ */
+template<class Job>
+class AsyncWorker : public coil::Task {
+ private:
+  typedef coil::Condition<coil::Mutex> Condition;
+  coil::Mutex m_m;
+  Condition m_cond;
+  std::vector<Job> m_jobs;
+  std::vector<Job*> m_free;
+  std::vector<Job*> m_pending; // Ring of the queued jobs, never more than the slots.
+  size_t m_pendingHead;
+  size_t m_pendingCount;
+  bool m_running;
+  bool m_active;
+  uint32_t m_processed;
+  uint32_t m_dropped;
+
+ public:
+ AsyncWorker() : m_cond(m_m), m_pendingHead(0), m_pendingCount(0), m_running(false), m_active(false), m_processed(0), m_dropped(0) {}
+  virtual ~AsyncWorker() { stop(); }
+
+ protected:
+  /**
+   * Called on the worker thread for every submitted job.
+   */
+  virtual void process(Job& job) = 0;
+
+ public:
+  void start(const uint32_t capacity) {
+    stop();
+    m_jobs.assign(capacity > 0 ? capacity : 1, Job());
+    m_free.clear();
+    m_pending.assign(m_jobs.size(), (Job*)NULL);
+    m_pendingHead = 0;
+    m_pendingCount = 0;
+    for(size_t i = 0;i < m_jobs.size();i++) {
+      m_free.push_back(&m_jobs[i]);
+    }
+    m_processed = 0;
+    m_dropped = 0;
+    m_running = true;
+    m_active = true;
+    activate();
+  }
+
+  /**
+   * Stop the worker. Queued jobs are discarded, the job in process is finished.
+   */
+  void stop() {
+    if (!m_active) {
+      return;
+    }
+    m_m.lock();
+    m_running = false;
+    m_cond.signal();
+    m_m.unlock();
+    wait();
+    m_active = false;
+  }
+
+  bool isRunning() const { return m_active; }
+
+  /**
+   * @return free job slot, or NULL if the only slot is in process.
+   */
+  Job* acquire() {
+    MutexBinder b(m_m);
+    if (!m_free.empty()) {
+      Job* job = m_free.back();
+      m_free.pop_back();
+      return job;
+    }
+    m_dropped++;
+    if (m_pendingCount == 0) {
+      return NULL;
+    }
+    return popPending();
+  }
+
+  /**
+   * Give back an acquired job without submitting it.
+   */
+  void release(Job* job) {
+    MutexBinder b(m_m);
+    m_free.push_back(job);
+  }
+
+  void submit(Job* job) {
+    MutexBinder b(m_m);
+    m_pending[(m_pendingHead + m_pendingCount) % m_pending.size()] = job;
+    m_pendingCount++;
+    m_cond.signal();
+  }
+
+  uint32_t processed() {
+    MutexBinder b(m_m);
+    return m_processed;
+  }
+
+  uint32_t dropped() {
+    MutexBinder b(m_m);
+    return m_dropped;
+  }
+
+  virtual int svc() {
+    while(true) {
+      m_m.lock();
+      while(m_running && m_pendingCount == 0) {
+	m_cond.wait();
+      }
+      if (!m_running) {
+	m_m.unlock();
+	break;
+      }
+      Job* job = popPending();
+      m_m.unlock();
+
+      process(*job);
+
+      m_m.lock();
+      m_processed++;
+      m_free.push_back(job);
+      m_m.unlock();
+    }
+    return 0;
+  }
+
+ private:
+  /**
+   * Oldest queued job, called with m_m locked.
+   */
+  Job* popPending() {
+    Job* job = m_pending[m_pendingHead];
+    m_pendingHead = (m_pendingHead + 1) % m_pending.size();
+    m_pendingCount--;
+    return job;
+  }
+};
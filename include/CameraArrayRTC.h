@@ -0,0 +1,382 @@
+// -*- C++ -*-
+/*!
+ * @file  CameraArrayRTC.h
+ * @brief Simulator Camera Array RTC
+ * @date  $Date$
+ *
+ * $Id$
+ */
+
+#ifndef CAMERAARRAYRTC_H
+#define CAMERAARRAYRTC_H
+
+#include <rtm/idl/BasicDataTypeSkel.h>
+#include <rtm/idl/ExtendedDataTypesSkel.h>
+#include <rtm/idl/InterfaceDataTypesSkel.h>
+#include <rtm/Manager.h>
+#include <rtm/DataFlowComponentBase.h>
+#include <rtm/CorbaPort.h>
+#include <rtm/DataInPort.h>
+#include <rtm/DataOutPort.h>
+
+#include <stdint.h>
+
+#include "ErrorCounter.h"
+#include "AllocationCheck.h"
+#include "ImageConversion.h"
+#include "WorkerPool.h"
+
+// Service implementation headers
+// <rtc-template block="service_impl_h">
+
+// </rtc-template>
+
+// Service Consumer stub headers
+// <rtc-template block="consumer_stub_h">
+
+// </rtc-template>
+
+#include <string>
+#include <vector>
+
+using namespace RTC;
+
+/*!
+ * @brief Converts the fetched images of the cameras into their tiles,
+ * one camera per WorkerPool index.
+ */
+class CameraArrayConversion : public ParallelTask {
+ public:
+  std::vector<ImageConverter> converters;
+  std::vector<const float*> images;
+  std::vector<const uint8_t*> charImages;
+  bool byteSource;  // charImages of this tick, else images
+  std::vector<int> offsets;
+  int stride;
+  uint8_t* dst;
+
+  virtual void execute(const int index) {
+    if (byteSource) {
+      converters[index].convert(charImages[index], dst + offsets[index], stride);
+    } else {
+      converters[index].convert(images[index], dst + offsets[index], stride);
+    }
+  }
+};
+
+
+/*!
+ * @class CameraArrayRTC
+ * @brief Simulator Camera Array RTC
+ *
+ */
+class CameraArrayRTC
+  : public RTC::DataFlowComponentBase
+{
+ public:
+  /*!
+   * @brief constructor
+   * @param manager Maneger Object
+   */
+  CameraArrayRTC(RTC::Manager* manager);
+
+  /*!
+   * @brief destructor
+   */
+  ~CameraArrayRTC();
+
+  // <rtc-template block="public_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="public_operation">
+  
+  // </rtc-template>
+
+  /***
+   *
+   * The initialize action (on CREATED->ALIVE transition)
+   * formaer rtc_init_entry() 
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onInitialize();
+
+  /***
+   *
+   * The finalize action (on ALIVE->END transition)
+   * formaer rtc_exiting_entry()
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onFinalize();
+
+  /***
+   *
+   * The startup action when ExecutionContext startup
+   * former rtc_starting_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onStartup(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The shutdown action when ExecutionContext stop
+   * former rtc_stopping_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onShutdown(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The activated action (Active state entry action)
+   * former rtc_active_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onActivated(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The deactivated action (Active state exit action)
+   * former rtc_active_exit()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onDeactivated(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The execution action that is invoked periodically
+   * former rtc_active_do()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onExecute(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The aborting action when main logic error occurred.
+   * former rtc_aborting_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onAborting(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The error action in ERROR state
+   * former rtc_error_do()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onError(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The reset action that is invoked resetting
+   * This is same but different the former rtc_init_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onReset(RTC::UniqueId ec_id);
+  
+  /***
+   *
+   * The state update action that is invoked after onExecute() action
+   * no corresponding operation exists in OpenRTm-aist-0.2.0
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onStateUpdate(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The action that is invoked when execution context's rate is changed
+   * no corresponding operation exists in OpenRTm-aist-0.2.0
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
+
+
+ protected:
+  // <rtc-template block="protected_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="protected_operation">
+  
+  // </rtc-template>
+
+  // Configuration variable declaration
+  // <rtc-template block="config_declare">
+  /*!
+   * 
+   * - Name:  objectName
+   * - DefaultValue: none
+   */
+  std::string m_objectName;
+
+  /*!
+   * tiled places the cameras in a grid of columns, batch stacks the
+   * frames so camera i starts at byte i*width*height*3 of the pixels.
+   * - Name:  layout
+   * - DefaultValue: tiled
+   * - Constraint: (tiled,batch)
+   */
+  std::string m_layout;
+
+  /*!
+   * Columns of the tiled layout, 0 for a square grid.
+   * - Name:  columns
+   * - DefaultValue: 0
+   * - Constraint: 0<=x
+   */
+  int m_columns;
+
+  /*!
+   * Image fetched from V-REP. "byte" uses the unsigned char image and
+   * skips the float conversion.
+   * - Name:  imageSource
+   * - DefaultValue: float
+   * - Constraint: (float,byte)
+   */
+  std::string m_imageSource;
+
+  /*!
+   * onDemand switches the vision sensors to explicit handling and renders
+   * them only on the ticks which publish. always leaves the
+   * handling set in the scene, scripts reading the sensor keep working.
+   * While an RTC with always reads the same sensor, it is rendered on
+   * every step.
+   * - Name:  renderMode
+   * - DefaultValue: always
+   * - Constraint: (always,onDemand)
+   */
+  std::string m_renderMode;
+
+  /*!
+   * Threads converting the images besides the simulation thread.
+   * - Name:  workerThreads
+   * - DefaultValue: 2
+   * - Constraint: 0<=x
+   */
+  int m_workerThreads;
+
+  /*!
+   * Publish every decimation-th tick.
+   * - Name:  decimation
+   * - DefaultValue: 1
+   * - Constraint: 1<=x
+   */
+  int m_decimation;
+
+  // </rtc-template>
+
+  // DataInPort declaration
+  // <rtc-template block="inport_declare">
+  // </rtc-template>
+
+
+  // DataOutPort declaration
+  // <rtc-template block="outport_declare">
+  RTC::CameraImage m_image;
+  /*!
+   */
+  OutPort<RTC::CameraImage> m_imageOut;
+  
+  // </rtc-template>
+
+  // CORBA Port declaration
+  // <rtc-template block="corbaport_declare">
+  
+  // </rtc-template>
+
+  // Service declaration
+  // <rtc-template block="service_declare">
+  
+  // </rtc-template>
+
+  // Consumer declaration
+  // <rtc-template block="consumer_declare">
+  
+  // </rtc-template>
+
+ private:
+  // <rtc-template block="private_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="private_operation">
+  
+  // </rtc-template>
+
+  std::vector<std::string> m_objectNames;
+  std::vector<int> m_objectHandles;
+  std::vector<bool> m_renderOnDemand;
+  int m_sensorWidth;
+  int m_sensorHeight;
+  uint32_t m_tick;
+  uint32_t m_tickPeriod;  // decimation checked at activation
+  ErrorCounter m_imageError;
+  AllocationCheck m_allocationCheck;
+  WorkerPool m_workerPool;
+  CameraArrayConversion m_conversion;
+
+  void requestRenderings();
+};
+
+
+extern "C"
+{
+  DLL_EXPORT void CameraArrayRTCInit(RTC::Manager* manager);
+};
+
+#endif // CAMERAARRAYRTC_H
@@ -21,6 +21,11 @@
 
 #include <stdint.h>
 
+#include "ErrorCounter.h"
+#include "AllocationCheck.h"
+#include "ImageEncoder.h"
+#include "ImageConversion.h"
+
 // Service implementation headers
 // <rtc-template block="service_impl_h">
 
@@ -243,6 +248,111 @@ class CameraRTC
    */
   std::string m_offsetStr;
 
+  /*!
+   * Image fetched from V-REP. "byte" uses the unsigned char image and
+   * skips the float conversion.
+   * - Name:  imageSource
+   * - DefaultValue: float
+   * - Constraint: (float,byte)
+   */
+  std::string m_imageSource;
+
+  /*!
+   * CameraImage format. jpeg and png are encoded on a worker thread.
+   * - Name:  format
+   * - DefaultValue: bitmap
+   * - Constraint: (bitmap,jpeg,png)
+   */
+  std::string m_format;
+
+  /*!
+   * 
+   * - Name:  jpegQuality
+   * - DefaultValue: 90
+   * - Constraint: 0<=x<=100
+   */
+  int m_jpegQuality;
+
+  /*!
+   * zlib compression level of png.
+   * - Name:  pngCompression
+   * - DefaultValue: 6
+   * - Constraint: 0<=x<=9
+   */
+  int m_pngCompression;
+
+  /*!
+   * Number of frames which can wait for the encoder. When full the oldest
+   * frame is dropped.
+   * - Name:  encodeQueue
+   * - DefaultValue: 2
+   * - Constraint: 1<=x
+   */
+  int m_encodeQueue;
+
+  /*!
+   * Region of interest x,y,width,height in the published image (top-left
+   * origin). 0 for width or height means up to the border.
+   * - Name:  roi
+   * - DefaultValue: 0,0,0,0
+   */
+  std::string m_roiStr;
+
+  /*!
+   * Average binning x binning pixel blocks.
+   * - Name:  binning
+   * - DefaultValue: 1
+   * - Constraint: (1,2,4)
+   */
+  int m_binning;
+
+  /*!
+   * Publish every decimation-th tick.
+   * - Name:  decimation
+   * - DefaultValue: 1
+   * - Constraint: 1<=x
+   */
+  int m_decimation;
+
+  /*!
+   * onDemand switches the vision sensor to explicit handling and renders
+   * it only on the ticks which publish. always leaves the
+   * handling set in the scene, scripts reading the sensor keep working.
+   * While an RTC with always reads the same sensor, it is rendered on
+   * every step.
+   * - Name:  renderMode
+   * - DefaultValue: always
+   * - Constraint: (always,onDemand)
+   */
+  std::string m_renderMode;
+
+  /*!
+   * Published pixel format. bgr8 and mono8 are "bitmap" images with bpp 24
+   * and 8, nv12 and rgb565 set the format field to their name.
+   * - Name:  pixelFormat
+   * - DefaultValue: bgr8
+   * - Constraint: (bgr8,mono8,nv12,rgb565)
+   */
+  std::string m_pixelFormatStr;
+
+  /*!
+   * Number of half resolution pyramid levels published on the ports
+   * imageLevel1..imageLevelN. The ports are made from the value given
+   * when the RTC is created, a later value only selects fewer of them.
+   * - Name:  pyramidLevels
+   * - DefaultValue: 0
+   * - Constraint: 0<=x<=4
+   */
+  int m_pyramidLevels;
+
+  /*!
+   * Comma separated decimation of each pyramid level (publish every N-th
+   * tick), independent from decimation of the image port.
+   * - Name:  pyramidRates
+   * - DefaultValue: 1
+   */
+  std::string m_pyramidRatesStr;
+
   // </rtc-template>
 
   // DataInPort declaration
@@ -256,6 +366,8 @@ class CameraRTC
   /*!
    */
   OutPort<RTC::CameraImage> m_imageOut;
+  std::vector<RTC::CameraImage*> m_levelImage;
+  std::vector<OutPort<RTC::CameraImage>*> m_levelOut;
   
   // </rtc-template>
 
@@ -284,9 +396,28 @@ class CameraRTC
   // </rtc-template>
 
   int m_objectHandle;
+  int m_sensorWidth;
+  int m_sensorHeight;
+  int m_width;
+  int m_height;
+  uint32_t m_tick;
+  uint32_t m_tickPeriod;  // decimation checked at activation
+  bool m_renderOnDemand;
+  int m_pixelFormat;
+  std::vector<uint8_t> m_bgr;
+  ImagePyramid m_pyramid;
+  std::vector<int> m_pyramidRates;
+  int m_levels;  // pyramid levels published since activation
   //int m_tubeHandle;
   //int m_bufferSize;
   //uint8_t* m_pBuffer;
+  ErrorCounter m_imageError;
+  AllocationCheck m_allocationCheck;
+  ImageEncodeWorker m_encodeWorker;
+  ImageConverter m_converter;
+
+  bool convertImage(uint8_t* dst, const float time);
+  bool publishes(const uint32_t tick, int* topLevel) const;
 };
 
 
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Back-projection of a V-REP depth buffer to 3D points.
+ *
+ * The ray of every pixel is computed once in configure(), so a frame is
+ * one multiply-add per coordinate (SSE where available). Points are in
+ * the sensor frame with x forward, y left and z up, in the pixel order of
+ * the depth buffer (bottom row first).
+ *
+ * The depth buffer holds 0.0-1.0 between the near and far clipping planes
+ * and is linearized to metres with them.
+ *
+ * setSensorPose() makes project() output world frame points, the rigid
+ * transform is applied in the same pass.
+ */
+class DepthProjection {
+ private:
+  int m_width;
+  int m_height;
+  float m_near;
+  float m_far;
+  std::vector<float> m_rayX;
+  std::vector<float> m_rayY;
+  std::vector<float> m_rayZ;
+  float m_focalLength;
+  bool m_transformed;
+  float m_transform[12];
+
+  void allocate(const int width, const int height, const float nearClipping, const float farClipping);
+
+ public:
+  DepthProjection() : m_width(0), m_height(0), m_near(0), m_far(1), m_focalLength(0), m_transformed(false) {}
+  ~DepthProjection() {}
+
+ public:
+  /**
+   * Perspective sensor. The depth is the distance along the view axis.
+   * @param perspectiveAngle view angle of the larger image dimension [rad]
+   */
+  void configurePinhole(const int width, const int height, const float perspectiveAngle,
+			const float nearClipping, const float farClipping);
+
+  /**
+   * Constant angle between the pixels. The depth is the distance along the ray.
+   * @param angularResolution angle between neighbour pixels [rad]
+   */
+  void configureSpherical(const int width, const int height, const double angularResolution,
+			  const float nearClipping, const float farClipping);
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  float nearClipping() const { return m_near; }
+  float farClipping() const { return m_far; }
+
+  /**
+   * @return focal length in pixels of a pinhole projection, 0 if spherical.
+   */
+  float focalLength() const { return m_focalLength; }
+
+  /**
+   * Project to the world frame from now on.
+   * @param matrix simGetObjectMatrix of the sensor (world frame)
+   */
+  void setSensorPose(const float* matrix);
+
+  /**
+   * Project to the sensor frame again.
+   */
+  void clearSensorPose() { m_transformed = false; }
+
+  /**
+   * @return metric depth of a depth buffer value.
+   */
+  float depth(const float value) const { return m_near + value * (m_far - m_near); }
+
+  /**
+   * Project pixels begin to end-1.
+   * @param depth width*height values of simGetVisionSensorDepthBuffer
+   * @param points 4 floats per pixel (x, y, z, 0) of the whole image
+   */
+  void project(const float* depth, float* points, const int begin, const int end) const;
+
+  /**
+   * Store the colour of pixels begin to end-1 in the 4th float of the
+   * points as uint32 0x00RRGGBB.
+   * @param image width*height*3 floats of simGetVisionSensorImage
+   */
+  void colour(const float* image, float* points, const int begin, const int end) const;
+
+  /**
+   * Metric depth image in millimetres, top row first. Pixels on the far
+   * clipping plane (no hit), beyond 65.535 m or with a negative depth
+   * are 0, so 0 always means no measurement.
+   */
+  void depthImage16(const float* depth, uint16_t* dst) const;
+
+  /**
+   * Metric depth image in metres, top row first. Pixels on the far
+   * clipping plane (no hit) are 0.
+   */
+  void depthImage32(const float* depth, float* dst) const;
+
+  /**
+   * Scalar reference of project().
+   */
+  void projectScalar(const float* depth, float* points, const int begin, const int end) const;
+
+  /**
+   * Scalar reference of depthImage16().
+   */
+  void depthImage16Scalar(const float* depth, uint16_t* dst) const;
+};
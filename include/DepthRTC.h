@@ -21,6 +21,12 @@
 
 #include <stdint.h>
 
+#include "ErrorCounter.h"
+#include "AllocationCheck.h"
+#include "DepthProjection.h"
+#include "PointCloudFilter.h"
+#include "WorkerPool.h"
+
 // Service implementation headers
 // <rtc-template block="service_impl_h">
 
@@ -36,6 +42,24 @@
 
 using namespace RTC;
 
+/*!
+ * @brief Back-projects a block of rows of the depth buffer into the
+ * point cloud (or the packed cloud when cloud is NULL), one block per
+ * WorkerPool index. Every block writes only its own points, so the
+ * output order does not depend on the threads.
+ */
+class DepthCloudTask : public ParallelTask {
+ public:
+  const DepthProjection* projection;
+  const float* depth;
+  const float* image;
+  float* points;
+  RTC::PointCloud* cloud;
+  int rowsPerBlock;
+
+  virtual void execute(const int index);
+};
+
 
 /*!
  * @class DepthRTC
@@ -236,11 +260,86 @@ class DepthRTC
    */
   std::string m_objectName;
   /*!
-   * 
+   * Angle between neighbour pixels [rad] of a spherical depth sensor.
+   * 0 uses the perspective angle of the vision sensor (pinhole model).
    * - Name:  angularResolution
-   * - DefaultValue: 0.9948
+   * - DefaultValue: 0
    */
   double m_angularResolution;
+  /*!
+   * onDemand switches the vision sensor to explicit handling and renders
+   * it only on the ticks which publish. always leaves the
+   * handling set in the scene, scripts reading the sensor keep working.
+   * While an RTC with always reads the same sensor, it is rendered on
+   * every step.
+   * - Name:  renderMode
+   * - DefaultValue: always
+   * - Constraint: (always,onDemand)
+   */
+  std::string m_renderMode;
+
+  /*!
+   * pointCloud publishes RTC::PointCloud, packed the float32 xyz + uint32
+   * rgb layout of PackedPointCloud.h on the packedPointCloud port.
+   * depth16 (millimetres) and depth32f (metres) publish a depth image on
+   * the depthImage port and its intrinsics on the intrinsics port; they
+   * need the pinhole projection (angularResolution 0).
+   * octree publishes the octree coded cloud of OctreeCodec.h on the
+   * octreePointCloud port and its statistics on compressionStats.
+   * - Name:  outputFormat
+   * - DefaultValue: pointCloud
+   * - Constraint: (pointCloud,packed,depth16,depth32f,octree)
+   */
+  std::string m_outputFormat;
+
+  /*!
+   * Publish every pointStride-th pixel of every pointStride-th row.
+   * - Name:  pointStride
+   * - DefaultValue: 1
+   * - Constraint: 1<=x
+   */
+  int m_pointStride;
+
+  /*!
+   * Edge [m] of the voxel grid filter, 0 to publish every point.
+   * - Name:  voxelSize
+   * - DefaultValue: 0.0
+   */
+  double m_voxelSize;
+
+  /*!
+   * Drop the points on the far clipping plane (nothing hit).
+   * - Name:  cullFarPlane
+   * - DefaultValue: off
+   * - Constraint: (on,off)
+   */
+  std::string m_cullFarPlane;
+
+  /*!
+   * Largest leaf edge [m] of the octree output. Replaces voxelSize there,
+   * the points of a leaf are merged.
+   * - Name:  octreeResolution
+   * - DefaultValue: 0.01
+   * - Constraint: 0<x
+   */
+  double m_octreeResolution;
+
+  /*!
+   * Frame of the points. world applies the sensor pose of the step, which
+   * is published on the sensorPose port.
+   * - Name:  frame
+   * - DefaultValue: sensor
+   * - Constraint: (sensor,world)
+   */
+  std::string m_frame;
+
+  /*!
+   * Threads projecting row blocks besides the simulation thread.
+   * - Name:  workerThreads
+   * - DefaultValue: 0
+   * - Constraint: 0<=x
+   */
+  int m_workerThreads;
 
   int m_width;
   int m_height;
@@ -258,6 +357,38 @@ class DepthRTC
   /*!
    */
   OutPort<RTC::PointCloud> m_pointCloudOut;
+  RTC::TimedOctetSeq m_packedPointCloud;
+  /*!
+   * PackedPointCloudHeader followed by the points
+   */
+  OutPort<RTC::TimedOctetSeq> m_packedPointCloudOut;
+  RTC::CameraImage m_depthImage;
+  /*!
+   * Depth image, top row first. 0 where nothing was hit.
+   */
+  OutPort<RTC::CameraImage> m_depthImageOut;
+  RTC::TimedDoubleSeq m_intrinsics;
+  /*!
+   * fx, fy, cx, cy [pixel], near and far clipping [m] of the depth image,
+   * same timestamp.
+   */
+  OutPort<RTC::TimedDoubleSeq> m_intrinsicsOut;
+  RTC::TimedOctetSeq m_octreePointCloud;
+  /*!
+   * OctreeCloudHeader followed by the occupancy bytes and leaf colours
+   */
+  OutPort<RTC::TimedOctetSeq> m_octreePointCloudOut;
+  RTC::TimedDoubleSeq m_compressionStats;
+  /*!
+   * Compression ratio, encode time [ms], points, leaves and bytes of every
+   * octree cloud, same timestamp.
+   */
+  OutPort<RTC::TimedDoubleSeq> m_compressionStatsOut;
+  RTC::TimedPose3D m_sensorPose;
+  /*!
+   * World pose of the sensor when the point cloud was taken, same timestamp
+   */
+  OutPort<RTC::TimedPose3D> m_sensorPoseOut;
   
   // </rtc-template>
 
@@ -286,9 +417,34 @@ class DepthRTC
   // </rtc-template>
 
   int m_objectHandle;
+  bool m_renderOnDemand;
   //int m_tubeHandle;
   //int m_bufferSize;
   //uint8_t* m_pBuffer;
+  ErrorCounter m_imageError;
+  AllocationCheck m_allocationCheck;
+  DepthProjection m_projection;
+  std::vector<float> m_points;
+  enum {
+    OUTPUT_POINT_CLOUD = 0,
+    OUTPUT_PACKED = 1,
+    OUTPUT_DEPTH16 = 2,
+    OUTPUT_DEPTH32F = 3,
+    OUTPUT_OCTREE = 4,
+  };
+  int m_outputMode;  // outputFormat the buffers were sized for at activation
+  bool m_filtered;
+  int m_filteredPoints;
+  int m_stride;       // pointStride checked at activation
+  bool m_cull;        // cullFarPlane at activation
+  bool m_worldFrame;  // frame at activation
+  PointCloudFilterWorker m_filterWorker;
+  PointCloudEncodeWorker m_encodeWorker;
+  AsyncWorker<PointCloudJob>* m_cloudWorker;
+  WorkerPool m_workerPool;
+  DepthCloudTask m_cloudTask;
+  int m_blocks;
+  uint32_t m_published;
 };
 
 
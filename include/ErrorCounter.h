@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Counts errors of a hot path and limits how often they are reported.
+ *
+ * raise() returns true for the first occurrence and then at most once per
+ * interval [sec] of simulation time. take() returns the number of
+ * occurrences since the last report, so the report can tell how many
+ * were suppressed.
+ */
+class ErrorCounter {
+ private:
+  double m_interval;
+  bool m_reported;
+  double m_lastReport;
+  uint32_t m_pending;
+  uint32_t m_total;
+
+ public:
+ ErrorCounter(const double interval=5.0) : m_interval(interval), m_reported(false), m_lastReport(0.0), m_pending(0), m_total(0) {}
+  ~ErrorCounter() {}
+
+ public:
+  bool raise(const double time) {
+    m_total++;
+    m_pending++;
+    if (m_reported && time >= m_lastReport && time - m_lastReport < m_interval) {
+      return false;
+    }
+    m_reported = true;
+    m_lastReport = time;
+    return true;
+  }
+
+  uint32_t take() {
+    uint32_t n = m_pending;
+    m_pending = 0;
+    return n;
+  }
+
+  uint32_t total() const { return m_total; }
+
+  void reset() {
+    m_reported = false;
+    m_pending = 0;
+    m_total = 0;
+  }
+};
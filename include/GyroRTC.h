@@ -21,6 +21,10 @@
 
 #include <stdint.h>
 
+#include "PublishFilter.h"
+#include "ErrorCounter.h"
+#include "AllocationCheck.h"
+
 // Service implementation headers
 // <rtc-template block="service_impl_h">
 
@@ -236,6 +240,28 @@ class GyroRTC
    */
   std::string m_objectName;
 
+  /*!
+   * Publish every tick (always) or only when the data changes (onChange).
+   * - Name:  publishMode
+   * - DefaultValue: always
+   * - Constraint: (always,onChange)
+   */
+  std::string m_publishMode;
+
+  /*!
+   * Changes smaller than this value are not published in onChange mode.
+   * - Name:  publishDeadband
+   * - DefaultValue: 0.0
+   */
+  double m_publishDeadband;
+
+  /*!
+   * Period [sec] to publish unchanged data in onChange mode (0 = never).
+   * - Name:  publishKeepAlive
+   * - DefaultValue: 1.0
+   */
+  double m_publishKeepAlive;
+
 
   // </rtc-template>
 
@@ -278,10 +304,13 @@ class GyroRTC
   // </rtc-template>
 
   int m_objectHandle;
+  PublishFilter m_publishFilter;
   int m_tubeHandle;
   int m_bufferSize;
   uint8_t* m_pBuffer;
 
+  ErrorCounter m_sizeError;
+  AllocationCheck m_allocationCheck;
 };
 
 
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Rectangle of an image, top-left origin. width or height 0 means
+ * up to the image border.
+ */
+struct ImageRegion {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+/**
+ * @brief Converts a region of a V-REP image (bottom row first) to 8 bit
+ * BGR (top row first) in one pass, optionally averaging binning x binning
+ * pixel blocks.
+ *
+ * Float values are scaled by 255, clamped to 0-255 and truncated, which
+ * matches the former per pixel conversion of CameraRTC for in-range
+ * values. The row kernel (SSE2, AVX2 or scalar) is chosen once at runtime
+ * from the CPU features.
+ *
+ * Binning converts the rows of a block to a scratch row, accumulates them
+ * in 16 bit and averages the block horizontally, all with SSE2 where
+ * available. configure() allocates the scratch rows, convert() does not.
+ */
+class ImageConverter {
+ private:
+  int m_sourceWidth;
+  int m_sourceHeight;
+  ImageRegion m_region;
+  int m_binning;
+  std::vector<uint8_t> m_rows;
+  std::vector<uint16_t> m_sum;
+
+ public:
+  ImageConverter();
+  ~ImageConverter();
+
+ public:
+  /**
+   * @param region clipped to the source and shrunk to a multiple of binning
+   * @param binning 1, 2 or 4
+   * @return false if the region is outside the source or binning is not supported.
+   */
+  bool configure(const int sourceWidth, const int sourceHeight, const ImageRegion& region, const int binning);
+
+  const ImageRegion& region() const { return m_region; }
+  int width() const { return m_region.width / m_binning; }
+  int height() const { return m_region.height / m_binning; }
+
+  /**
+   * @param src sourceWidth*sourceHeight*3 floats from simGetVisionSensorImage
+   * @param dst width()*height()*3 bytes
+   * @param dstStride bytes between the output rows, 0 for width()*3
+   */
+  void convert(const float* src, uint8_t* dst, const int dstStride = 0);
+
+  /**
+   * @param src sourceWidth*sourceHeight*3 bytes from simGetVisionSensorCharImage
+   * @param dst width()*height()*3 bytes
+   * @param dstStride bytes between the output rows, 0 for width()*3
+   */
+  void convert(const uint8_t* src, uint8_t* dst, const int dstStride = 0);
+};
+
+/**
+ * @brief Image pyramid of a BGR image. Level k is 2^k times smaller than
+ * the base (level 0), each level is the 2x2 box filtered previous one.
+ *
+ * configure() allocates all levels, build() only computes them.
+ */
+class ImagePyramid {
+ private:
+  std::vector<std::vector<uint8_t> > m_levels;
+  std::vector<int> m_widths;
+  std::vector<int> m_heights;
+  std::vector<uint16_t> m_sum;
+  std::vector<uint8_t> m_tmp;
+
+ public:
+  ImagePyramid() {}
+  ~ImagePyramid() {}
+
+ public:
+  /**
+   * @return false if the smallest level would be empty.
+   */
+  bool configure(const int width, const int height, const int levels);
+
+  int levels() const { return (int)m_widths.size() - 1; }
+  int width(const int level) const { return m_widths[level]; }
+  int height(const int level) const { return m_heights[level]; }
+
+  /**
+   * Compute levels 1 to top from the base image.
+   */
+  void build(const uint8_t* base, const int top);
+
+  /**
+   * BGR image of level 1 to levels().
+   */
+  const uint8_t* level(const int level) const { return &m_levels[level - 1][0]; }
+};
+
+/**
+ * @brief Pixel formats which CameraRTC can publish.
+ *
+ * BGR8 is the 24 bit "bitmap" image, MONO8 the BT.601 luma, NV12 a full
+ * resolution Y plane followed by an interleaved half resolution UV plane,
+ * RGB565 little endian 16 bit pixels.
+ */
+enum {
+  PIXEL_BGR8 = 0,
+  PIXEL_MONO8 = 1,
+  PIXEL_NV12 = 2,
+  PIXEL_RGB565 = 3,
+};
+
+/**
+ * @return PIXEL_* of "bgr8", "mono8", "nv12" or "rgb565", -1 if unknown.
+ */
+int parsePixelFormat(const std::string& name);
+
+/**
+ * @return bits per pixel of the format (24, 8, 12, 16).
+ */
+int pixelFormatBpp(const int format);
+
+/**
+ * @return bytes of a width x height image. NV12 needs even width and height.
+ */
+int pixelFormatSize(const int format, const int width, const int height);
+
+/**
+ * @brief Convert a BGR image (top row first) to another pixel format.
+ *
+ * mono8, the Y plane of NV12 and rgb565 use AVX2 kernels when available,
+ * the UV plane of NV12 averages 2x2 blocks in scalar code.
+ */
+void convertBGRImage(const uint8_t* bgr, const int width, const int height, const int format, uint8_t* dst);
+
+/**
+ * @brief Scalar reference of convertBGRImage.
+ */
+void convertBGRImageScalar(const uint8_t* bgr, const int width, const int height, const int format, uint8_t* dst);
+
+/**
+ * @brief Name of the row kernel used by ImageConverter ("avx2", "sse2" or "scalar").
+ */
+const char* imageConversionKernel();
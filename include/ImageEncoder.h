@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <rtm/idl/InterfaceDataTypesSkel.h>
+#include <rtm/DataOutPort.h>
+
+#include "AsyncWorker.h"
+
+/**
+ * @brief Encode a BGR (or mono when channels == 1) image to JPEG.
+ *
+ * Available when the plugin is built with RTC_USE_JPEG (libjpeg).
+ * @return false if the encoder is not available or failed.
+ */
+bool encodeJpeg(const uint8_t* image, const int width, const int height, const int channels,
+		const int quality, std::vector<uint8_t>& out);
+
+/**
+ * @brief Encode a BGR (or mono when channels == 1) image to PNG.
+ *
+ * Available when the plugin is built with RTC_USE_PNG (libpng).
+ * @return false if the encoder is not available or failed.
+ */
+bool encodePng(const uint8_t* image, const int width, const int height, const int channels,
+	       const int compression, std::vector<uint8_t>& out);
+
+/**
+ * @return true if the CameraImage format ("bitmap", "jpeg", "png") can be produced.
+ */
+bool isImageFormatSupported(const std::string& format);
+
+
+/**
+ * @brief Raw frame handed to the ImageEncodeWorker.
+ */
+struct EncodeJob {
+  std::vector<uint8_t> image;
+  int width;
+  int height;
+  int channels;
+  double time;
+
+EncodeJob() : width(0), height(0), channels(3), time(0.0) {}
+};
+
+/**
+ * @brief Compresses camera frames and writes them to an OutPort on its own
+ * thread, so the simulation step never waits for the encoder.
+ */
+class ImageEncodeWorker : public AsyncWorker<EncodeJob> {
+ private:
+  RTC::OutPort<RTC::CameraImage>& m_port;
+  RTC::CameraImage m_image;
+  std::vector<uint8_t> m_buffer;
+  std::string m_format;
+  int m_quality;
+  int m_compression;
+  uint32_t m_failed;
+
+ public:
+  ImageEncodeWorker(RTC::OutPort<RTC::CameraImage>& port);
+  virtual ~ImageEncodeWorker();
+
+ public:
+  /**
+   * Must be called while the worker is stopped.
+   */
+  void configure(const std::string& format, const int quality, const int compression);
+
+  uint32_t failed() const { return m_failed; }
+
+ protected:
+  virtual void process(EncodeJob& job);
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Fixed capacity ring of joint samples recorded on every physics step.
+ *
+ * Each sample row holds position, velocity and force of all observed joints
+ * ([pos0..posN-1, vel0..velN-1, force0..forceN-1]). When the ring is full
+ * the oldest row is overwritten and counted as overflow.
+ */
+class JointSampleRing {
+ private:
+  uint32_t m_jointCount;
+  uint32_t m_capacity;
+  uint32_t m_head;
+  uint32_t m_count;
+  uint32_t m_overflow;
+  std::vector<double> m_rows;
+  std::vector<double> m_times;
+
+ public:
+ JointSampleRing() : m_jointCount(0), m_capacity(0), m_head(0), m_count(0), m_overflow(0) {}
+  ~JointSampleRing() {}
+
+ public:
+  void resize(const uint32_t jointCount, const uint32_t capacity) {
+    m_jointCount = jointCount;
+    m_capacity = capacity > 0 ? capacity : 1;
+    m_rows.assign(m_capacity * m_jointCount * 3, 0.0);
+    m_times.assign(m_capacity, 0.0);
+    m_overflow = 0;
+    clear();
+  }
+
+  void clear() {
+    m_head = 0;
+    m_count = 0;
+  }
+
+  uint32_t jointCount() const { return m_jointCount; }
+  uint32_t size() const { return m_count; }
+  bool empty() const { return m_count == 0; }
+  uint32_t overflow() const { return m_overflow; }
+
+  /**
+   * Reserve the next row and return it for writing.
+   */
+  double* next(const double time) {
+    uint32_t index = (m_head + m_count) % m_capacity;
+    if (m_count == m_capacity) {
+      m_head = (m_head + 1) % m_capacity;
+      m_overflow++;
+    } else {
+      m_count++;
+    }
+    m_times[index] = time;
+    return &m_rows[index * m_jointCount * 3];
+  }
+
+  /**
+   * Row of i-th sample (0 is the oldest one).
+   */
+  const double* at(const uint32_t i) const {
+    return &m_rows[((m_head + i) % m_capacity) * m_jointCount * 3];
+  }
+
+  double timeAt(const uint32_t i) const {
+    return m_times[(m_head + i) % m_capacity];
+  }
+
+  const double* latest() const {
+    return at(m_count - 1);
+  }
+
+  double latestTime() const {
+    return timeAt(m_count - 1);
+  }
+};
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * @brief Octree compressed point cloud published by DepthRTC as
+ * RTC::TimedOctetSeq.
+ *
+ * The data starts with this header, followed by the occupancy bytes of the
+ * octree in breadth first order (one byte per inner node, bit k set if
+ * child k is occupied, child k = x | y << 1 | z << 2) and one RGB565
+ * colour (uint16) per leaf in the order the leaves are reached. Each leaf
+ * stands for the points in it, decoded at the leaf centre with their mean
+ * colour. All values are little endian.
+ *
+ * This header only needs the standard library, so monitoring tools can
+ * copy it and decode with decodeOctreeCloud().
+ */
+struct OctreeCloudHeader {
+  char magic[4];      // "OCT1"
+  uint32_t leaves;
+  uint32_t nodes;     // occupancy bytes
+  uint32_t depth;
+  uint32_t flags;     // PACKED_POINT_* of PackedPointCloud.h
+  float origin[3];    // minimum corner of the octree cube
+  float size;         // edge of the octree cube
+  float pose[12];     // simGetObjectMatrix of the sensor
+};
+
+static const uint32_t OCTREE_MAX_DEPTH = 16;
+
+/**
+ * @brief Morton code of a cell, 3 bits per level with the root child in
+ * the highest bits.
+ */
+inline uint64_t octreeSpreadBits(uint64_t v) {
+  v &= 0x1FFFFF;
+  v = (v | v << 32) & 0x1F00000000FFFFULL;
+  v = (v | v << 16) & 0x1F0000FF0000FFULL;
+  v = (v | v << 8) & 0x100F00F00F00F00FULL;
+  v = (v | v << 4) & 0x10C30C30C30C30C3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+inline uint32_t octreeCompactBits(uint64_t v) {
+  v &= 0x1249249249249249ULL;
+  v = (v | v >> 2) & 0x10C30C30C30C30C3ULL;
+  v = (v | v >> 4) & 0x100F00F00F00F00FULL;
+  v = (v | v >> 8) & 0x1F0000FF0000FFULL;
+  v = (v | v >> 16) & 0x1F00000000FFFFULL;
+  v = (v | v >> 32) & 0x1FFFFF;
+  return (uint32_t)v;
+}
+
+/**
+ * @brief Encodes point clouds (4 floats per point: x, y, z and uint32
+ * 0x00RRGGBB) to the octree format.
+ *
+ * The depth is the smallest one whose leaves are not larger than the
+ * resolution, so the resolution bounds the position error to half a leaf
+ * diagonal. configure() allocates for the largest cloud, encode() does not.
+ */
+class OctreeEncoder {
+ private:
+  struct Leaf {
+    uint64_t key;
+    uint32_t rgb;
+    bool operator<(const Leaf& other) const { return key < other.key; }
+  };
+  std::vector<Leaf> m_leaves;
+  std::vector<uint64_t> m_keys;
+  std::vector<uint16_t> m_colours;
+
+ public:
+  OctreeEncoder() {}
+  ~OctreeEncoder() {}
+
+ public:
+  /**
+   * @param out receives the encoded clouds, reserved for maxPoints
+   */
+  void configure(const int maxPoints, std::vector<uint8_t>& out) {
+    m_leaves.resize(maxPoints > 0 ? maxPoints : 1);
+    m_keys.resize(m_leaves.size());
+    m_colours.resize(m_leaves.size());
+    out.reserve(sizeof(OctreeCloudHeader) + m_leaves.size() * (OCTREE_MAX_DEPTH + 2));
+  }
+
+  /**
+   * @param header flags and pose are taken from it, the rest is filled in
+   * @return size of the encoded cloud in out
+   */
+  size_t encode(const float* points, const int count, const float resolution,
+		OctreeCloudHeader& header, std::vector<uint8_t>& out) {
+    memcpy(header.magic, "OCT1", 4);
+    float lower[3] = {0, 0, 0};
+    float upper[3] = {0, 0, 0};
+    for(int i = 0;i < count;i++) {
+      for(int k = 0;k < 3;k++) {
+	const float v = points[i * 4 + k];
+	if (i == 0 || v < lower[k]) lower[k] = v;
+	if (i == 0 || v > upper[k]) upper[k] = v;
+      }
+    }
+    float size = std::max(upper[0] - lower[0], std::max(upper[1] - lower[1], upper[2] - lower[2]));
+    uint32_t depth = 0;
+    if (count > 0) {
+      size = std::max(size, resolution > 0 ? resolution : 1e-6f);
+      while(depth < OCTREE_MAX_DEPTH && size / (1 << depth) > resolution) {
+	depth++;
+      }
+    }
+    memcpy(header.origin, lower, sizeof(lower));
+    header.size = size;
+    header.depth = depth;
+
+    // Quantize to the leaf grid and merge the points of a leaf.
+    const uint32_t cells = 1u << depth;
+    const float scale = (count > 0) ? cells / size : 0;
+    for(int i = 0;i < count;i++) {
+      const float* p = points + i * 4;
+      uint32_t cell[3];
+      for(int k = 0;k < 3;k++) {
+	const uint32_t c = (uint32_t)((p[k] - lower[k]) * scale);
+	cell[k] = c < cells ? c : cells - 1;
+      }
+      m_leaves[i].key = octreeSpreadBits(cell[0]) | octreeSpreadBits(cell[1]) << 1 | octreeSpreadBits(cell[2]) << 2;
+      memcpy(&m_leaves[i].rgb, p + 3, 4);
+    }
+    std::sort(m_leaves.begin(), m_leaves.begin() + count);
+    uint32_t leaves = 0;
+    for(int i = 0;i < count;) {
+      uint32_t sum[3] = {0, 0, 0};
+      int j = i;
+      for(;j < count && m_leaves[j].key == m_leaves[i].key;j++) {
+	sum[0] += (m_leaves[j].rgb >> 16) & 0xFF;
+	sum[1] += (m_leaves[j].rgb >> 8) & 0xFF;
+	sum[2] += m_leaves[j].rgb & 0xFF;
+      }
+      const uint32_t n = j - i;
+      m_keys[leaves] = m_leaves[i].key;
+      m_colours[leaves] = (uint16_t)(((sum[0] / n) >> 3) << 11 | ((sum[1] / n) >> 2) << 5 | ((sum[2] / n) >> 3));
+      leaves++;
+      i = j;
+    }
+    header.leaves = leaves;
+
+    // One pass over the sorted leaves per level yields the nodes of the
+    // level in the order the decoder expands them.
+    out.resize(sizeof(OctreeCloudHeader));
+    for(uint32_t level = 0;level < depth;level++) {
+      const uint32_t shift = 3 * (depth - 1 - level);
+      uint64_t parent = 0;
+      uint8_t occupancy = 0;
+      for(uint32_t i = 0;i < leaves;i++) {
+	const uint64_t child = m_keys[i] >> shift;
+	if (occupancy != 0 && (child >> 3) != parent) {
+	  out.push_back(occupancy);
+	  occupancy = 0;
+	}
+	parent = child >> 3;
+	occupancy |= (uint8_t)(1 << (child & 7));
+      }
+      if (occupancy != 0) {
+	out.push_back(occupancy);
+      }
+    }
+    header.nodes = (uint32_t)(out.size() - sizeof(OctreeCloudHeader));
+    out.resize(out.size() + leaves * sizeof(uint16_t));
+    if (leaves > 0) {
+      memcpy(&out[sizeof(OctreeCloudHeader) + header.nodes], &m_colours[0], leaves * sizeof(uint16_t));
+    }
+    memcpy(&out[0], &header, sizeof(header));
+    return out.size();
+  }
+};
+
+/**
+ * @brief Decodes an octree cloud to 4 floats per point (x, y, z at the
+ * leaf centres and uint32 0x00RRGGBB).
+ *
+ * @return false if the data is not a complete octree cloud.
+ */
+inline bool decodeOctreeCloud(const uint8_t* data, const size_t size, OctreeCloudHeader& header,
+			      std::vector<float>& points) {
+  if (size < sizeof(OctreeCloudHeader)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, "OCT1", 4) != 0 || header.depth > OCTREE_MAX_DEPTH ||
+      size != sizeof(header) + header.nodes + (size_t)header.leaves * sizeof(uint16_t)) {
+    return false;
+  }
+  const uint8_t* occupancy = data + sizeof(header);
+  std::vector<uint64_t> nodes(header.leaves > 0 ? 1 : 0, 0);
+  std::vector<uint64_t> children;
+  uint32_t read = 0;
+  for(uint32_t level = 0;level < header.depth;level++) {
+    children.clear();
+    for(size_t i = 0;i < nodes.size();i++) {
+      if (read >= header.nodes) {
+	return false;
+      }
+      const uint8_t byte = occupancy[read++];
+      for(int k = 0;k < 8;k++) {
+	if (byte & (1 << k)) {
+	  children.push_back(nodes[i] << 3 | k);
+	}
+      }
+    }
+    nodes.swap(children);
+  }
+  if (read != header.nodes || nodes.size() != header.leaves) {
+    return false;
+  }
+  const uint8_t* colours = occupancy + header.nodes;
+  const float leaf = header.size / (1 << header.depth);
+  points.resize(header.leaves * 4);
+  for(uint32_t i = 0;i < header.leaves;i++) {
+    float* p = &points[i * 4];
+    for(int k = 0;k < 3;k++) {
+      p[k] = header.origin[k] + (octreeCompactBits(nodes[i] >> k) + 0.5f) * leaf;
+    }
+    uint16_t c;
+    memcpy(&c, colours + i * sizeof(uint16_t), sizeof(c));
+    const uint32_t r = (c >> 11) & 0x1F, g = (c >> 5) & 0x3F, b = c & 0x1F;
+    const uint32_t rgb = ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+    memcpy(p + 3, &rgb, 4);
+  }
+  return true;
+}
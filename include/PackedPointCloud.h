@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Layout of the packed point cloud published by DepthRTC as
+ * RTC::TimedOctetSeq.
+ *
+ * The data starts with this header, followed by width*height points of
+ * PACKED_POINT_SIZE bytes (float x, y, z and uint32 rgb as 0x00RRGGBB),
+ * all little endian. The cloud is organized: point (row, column) is at
+ * index row*width+column, rows from the bottom of the image. Pixels
+ * without a hit lie on the far clipping plane.
+ *
+ * pose is the sensor pose in the world frame when the cloud was taken, as
+ * returned by simGetObjectMatrix (3x4 row major, the vision sensor looks
+ * along its z axis).
+ */
+struct PackedPointCloudHeader {
+  char magic[4];       // "PPC1"
+  uint32_t width;
+  uint32_t height;
+  uint32_t pointSize;  // bytes per point
+  uint32_t flags;      // PACKED_POINT_*
+  float nearClipping;
+  float farClipping;
+  uint32_t reserved;
+  float pose[12];
+};
+
+static const uint32_t PACKED_POINT_SIZE = 16;
+
+/**
+ * Points are in the sensor frame (x forward, y left, z up).
+ */
+static const uint32_t PACKED_POINT_SENSOR_FRAME = 0;
+
+/**
+ * Points are in the world frame.
+ */
+static const uint32_t PACKED_POINT_WORLD_FRAME = 1;
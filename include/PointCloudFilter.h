@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <rtm/idl/BasicDataTypeSkel.h>
+#include <rtm/idl/InterfaceDataTypesSkel.h>
+#include <rtm/DataOutPort.h>
+
+#include "AsyncWorker.h"
+#include "OctreeCodec.h"
+#include "VoxelGrid.h"
+
+/**
+ * @brief Point cloud handed from DepthRTC to the PointCloudFilterWorker.
+ */
+struct PointCloudJob {
+  std::vector<float> points;  // 4 floats per point (x, y, z, rgb)
+  int count;
+  double time;
+  uint32_t flags;             // PACKED_POINT_*
+  float pose[12];             // simGetObjectMatrix of the sensor
+
+PointCloudJob() : count(0), time(0.0), flags(0) {}
+};
+
+/**
+ * @brief Voxel filters the culled and strided clouds of DepthRTC and writes
+ * them as RTC::PointCloud or as packed cloud (PackedPointCloud.h, height 1)
+ * on its own thread.
+ */
+class PointCloudFilterWorker : public AsyncWorker<PointCloudJob> {
+ private:
+  RTC::OutPort<RTC::PointCloud>& m_cloudPort;
+  RTC::OutPort<RTC::TimedOctetSeq>& m_packedPort;
+  RTC::PointCloud m_cloud;
+  RTC::TimedOctetSeq m_packed;
+  VoxelGrid m_grid;
+  bool m_packedFormat;
+  float m_nearClipping;
+  float m_farClipping;
+  uint32_t m_inputPoints;
+  uint32_t m_outputPoints;
+
+ public:
+  PointCloudFilterWorker(RTC::OutPort<RTC::PointCloud>& cloudPort, RTC::OutPort<RTC::TimedOctetSeq>& packedPort);
+  virtual ~PointCloudFilterWorker();
+
+ public:
+  /**
+   * Must be called while the worker is stopped.
+   */
+  void configure(const bool packed, const int maxPoints, const float voxelSize,
+		 const float nearClipping, const float farClipping);
+
+  /**
+   * Points received and published since configure(), read after stop().
+   */
+  uint32_t inputPoints() const { return m_inputPoints; }
+  uint32_t outputPoints() const { return m_outputPoints; }
+
+ protected:
+  virtual void process(PointCloudJob& job);
+};
+
+
+/**
+ * @brief Octree encodes the culled and strided clouds of DepthRTC
+ * (OctreeCodec.h) and writes them with the statistics of every frame on
+ * its own thread.
+ *
+ * The statistics are compression ratio (packed cloud bytes / octree
+ * bytes), encode time [ms], input points, leaves and octree bytes.
+ */
+class PointCloudEncodeWorker : public AsyncWorker<PointCloudJob> {
+ private:
+  RTC::OutPort<RTC::TimedOctetSeq>& m_octreePort;
+  RTC::OutPort<RTC::TimedDoubleSeq>& m_statsPort;
+  RTC::TimedOctetSeq m_octree;
+  RTC::TimedDoubleSeq m_stats;
+  OctreeEncoder m_encoder;
+  std::vector<uint8_t> m_buffer;
+  float m_resolution;
+  double m_rawBytes;
+  double m_encodedBytes;
+  double m_encodeTime;
+
+ public:
+  PointCloudEncodeWorker(RTC::OutPort<RTC::TimedOctetSeq>& octreePort, RTC::OutPort<RTC::TimedDoubleSeq>& statsPort);
+  virtual ~PointCloudEncodeWorker();
+
+ public:
+  /**
+   * Must be called while the worker is stopped.
+   * @param resolution largest leaf edge [m]
+   */
+  void configure(const int maxPoints, const float resolution);
+
+  /**
+   * Totals since configure(), read after stop().
+   */
+  double compressionRatio() const { return m_encodedBytes > 0 ? m_rawBytes / m_encodedBytes : 0; }
+  double encodeTime() const { return m_encodeTime; }
+
+ protected:
+  virtual void process(PointCloudJob& job);
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * @brief Change detection in front of OutPort::write.
+ *
+ * In "onChange" mode the data is published only when a value moved more than
+ * the deadband since the last publication, or when keepAlive seconds passed
+ * (keepAlive <= 0 disables the keep-alive). "always" publishes every tick.
+ */
+class PublishFilter {
+ private:
+  bool m_onChange;
+  double m_deadband;
+  double m_keepAlive;
+  bool m_published;
+  double m_lastTime;
+  std::vector<double> m_last;
+
+ public:
+ PublishFilter() : m_onChange(false), m_deadband(0.0), m_keepAlive(0.0), m_published(false), m_lastTime(0.0) {}
+  ~PublishFilter() {}
+
+ public:
+  void configure(const std::string& mode, const double deadband, const double keepAlive) {
+    m_onChange = (mode == "onChange");
+    m_deadband = deadband;
+    m_keepAlive = keepAlive;
+    reset();
+  }
+
+  void reset() {
+    m_published = false;
+  }
+
+  /**
+   * @return true if the values should be written.
+   */
+  bool check(const double* values, const uint32_t size, const double time) {
+    if (!m_onChange) {
+      return true;
+    }
+    bool changed = !m_published || m_last.size() != size ||
+      (m_keepAlive > 0 && time - m_lastTime >= m_keepAlive);
+    for(uint32_t i = 0;i < size && !changed;i++) {
+      if (fabs(values[i] - m_last[i]) > m_deadband) {
+	changed = true;
+      }
+    }
+    if (!changed) {
+      return false;
+    }
+    m_last.assign(values, values + size);
+    m_lastTime = time;
+    m_published = true;
+    return true;
+  }
+};
@@ -55,14 +55,18 @@ public:
 bool initRTM();
 bool exitRTM();
 int spawnRobotRTC(std::string& key, std::string& arg);
+int spawnRobotFleetRTC(std::string& key, std::string& arg);
 int spawnRangeRTC(std::string& key, std::string& arg);
 int spawnCameraRTC(std::string& key, std::string& arg);
+int spawnCameraArrayRTC(std::string& key, std::string& arg);
+int spawnStereoCameraRTC(std::string& key, std::string& arg);
 int spawnAccelerometerRTC(std::string& key, std::string& arg);
 int spawnGyroRTC(std::string& key, std::string& arg);
 int spawnDepthRTC(std::string& key, std::string& arg);
 int spawnObjectRTC(std::string& key, std::string& arg);
 void startRTCs();
 void stopRTCs();
+void stepRTCs(const float time, const float timeStep);
 void tickRTCs(const float interval);
 int killRTC(const std::string& key);
 int killAllRTC();
@@ -21,6 +21,10 @@
 
 #include <stdint.h>
 
+#include "ErrorCounter.h"
+#include "AllocationCheck.h"
+#include "RangeScan.h"
+
 // Service implementation headers
 // <rtc-template block="service_impl_h">
 
@@ -247,6 +251,16 @@ class RangeRTC
 
   double m_minRange;
 
+  /*!
+   * Messages in the tube are all read every tick. latest publishes the
+   * newest scan, all publishes every scan, average the mean range of
+   * every ray over the scans of the tick.
+   * - Name:  drainPolicy
+   * - DefaultValue: latest
+   * - Constraint: (latest,all,average)
+   */
+  std::string m_drainPolicy;
+
   // </rtc-template>
 
   // DataInPort declaration
@@ -293,6 +307,20 @@ class RangeRTC
   uint8_t* m_pBuffer;
 
   bool isInitRangeConfig();
+  void prepareRanges(const int ray_size);
+  AllocationCheck m_allocationCheck;
+  RangeScan m_scan;
+  std::vector<double> m_scanRanges;
+  std::vector<double> m_rangeSum;
+  std::vector<uint32_t> m_rangeHits;
+  uint32_t m_publishedScans;
+  // Read but not published: superseded (latest) or of another ray count
+  // than the following messages (average).
+  uint32_t m_droppedMessages;
+  // Left in the tube by the drain limit of an earlier tick.
+  uint32_t m_staleMessages;
+  int m_leftMessages;          // left in the tube by the drain limit of the last tick
+
 };
 
 
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Scan of a laser range finder as written to the tube by the
+ * V-REP Hokuyo script: x, y, z (float) of the detected point of every
+ * ray in the sensor frame, 0 where nothing was detected.
+ *
+ * The beam angles do not change between scans, so the angular resolution
+ * is computed from the first scan with enough detected points and kept
+ * for the following ones. Distances are computed four rays at a time
+ * with SSE where available.
+ */
+class RangeScan {
+ private:
+  std::vector<float> m_points;
+  int m_rays;
+  double m_angularResolution;
+
+ public:
+  RangeScan() : m_rays(0), m_angularResolution(0) {}
+  ~RangeScan() {}
+
+ public:
+  /**
+   * Copy a tube message. A different number of rays than the resolution
+   * was computed for drops the resolution.
+   * @return number of rays
+   */
+  int decode(const char* payload, const int size);
+
+  int rays() const { return m_rays; }
+  const float* points() const { return &m_points[0]; }
+
+  /**
+   * Compute the angular resolution from the current scan, if not done yet.
+   * @return false while no two neighbour rays detected a point.
+   */
+  bool calibrate();
+
+  bool isCalibrated() const { return m_angularResolution != 0.0; }
+
+  /**
+   * Angle between neighbour rays [rad], the rays are symmetric about the
+   * sensor x axis.
+   */
+  double angularResolution() const { return m_angularResolution; }
+
+  /**
+   * Distance in the sensor xy plane of every ray, at most maxRange.
+   * @param ranges rays() values
+   */
+  void distances(const double maxRange, double* ranges) const;
+
+  /**
+   * Scalar reference of distances().
+   */
+  void distancesScalar(const double maxRange, double* ranges) const;
+};
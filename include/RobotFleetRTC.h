@@ -0,0 +1,353 @@
+// -*- C++ -*-
+/*!
+ * @file  RobotFleetRTC.h
+ * @brief Simulator Robot Fleet RTC
+ * @date  $Date$
+ *
+ * $Id$
+ */
+
+#ifndef ROBOTFLEETRTC_H
+#define ROBOTFLEETRTC_H
+
+#include <rtm/idl/BasicDataTypeSkel.h>
+#include <rtm/idl/ExtendedDataTypesSkel.h>
+#include <rtm/idl/InterfaceDataTypesSkel.h>
+#include <rtm/Manager.h>
+#include <rtm/DataFlowComponentBase.h>
+#include <rtm/CorbaPort.h>
+#include <rtm/DataInPort.h>
+#include <rtm/DataOutPort.h>
+
+#include <stdint.h>
+
+#include "RobotRTC.h"
+#include "PublishFilter.h"
+#include "ErrorCounter.h"
+#include "AllocationCheck.h"
+
+// Service implementation headers
+// <rtc-template block="service_impl_h">
+
+// </rtc-template>
+
+// Service Consumer stub headers
+// <rtc-template block="consumer_stub_h">
+
+// </rtc-template>
+
+#include <string>
+#include <vector>
+
+using namespace RTC;
+
+/*!
+ * @class RobotFleetRTC
+ * @brief Simulator Robot Fleet RTC
+ *
+ */
+class RobotFleetRTC
+  : public RTC::DataFlowComponentBase
+{
+ public:
+  /*!
+   * @brief constructor
+   * @param manager Maneger Object
+   */
+  RobotFleetRTC(RTC::Manager* manager);
+
+  /*!
+   * @brief destructor
+   */
+  ~RobotFleetRTC();
+
+  // <rtc-template block="public_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="public_operation">
+  
+  // </rtc-template>
+
+  /***
+   *
+   * The initialize action (on CREATED->ALIVE transition)
+   * formaer rtc_init_entry() 
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onInitialize();
+
+  /***
+   *
+   * The finalize action (on ALIVE->END transition)
+   * formaer rtc_exiting_entry()
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onFinalize();
+
+  /***
+   *
+   * The startup action when ExecutionContext startup
+   * former rtc_starting_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onStartup(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The shutdown action when ExecutionContext stop
+   * former rtc_stopping_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onShutdown(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The activated action (Active state entry action)
+   * former rtc_active_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onActivated(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The deactivated action (Active state exit action)
+   * former rtc_active_exit()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onDeactivated(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The execution action that is invoked periodically
+   * former rtc_active_do()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onExecute(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The aborting action when main logic error occurred.
+   * former rtc_aborting_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onAborting(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The error action in ERROR state
+   * former rtc_error_do()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onError(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The reset action that is invoked resetting
+   * This is same but different the former rtc_init_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onReset(RTC::UniqueId ec_id);
+  
+  /***
+   *
+   * The state update action that is invoked after onExecute() action
+   * no corresponding operation exists in OpenRTm-aist-0.2.0
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onStateUpdate(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The action that is invoked when execution context's rate is changed
+   * no corresponding operation exists in OpenRTm-aist-0.2.0
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
+
+
+ protected:
+  // <rtc-template block="protected_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="protected_operation">
+  
+  // </rtc-template>
+
+  // Configuration variable declaration
+  // <rtc-template block="config_declare">
+  /*!
+   * 
+   * - Name:  objectName
+   * - DefaultValue: none
+   */
+  std::string m_objectName;
+
+  /*!
+   * Publish every tick (always) or only when the data changes (onChange).
+   * - Name:  publishMode
+   * - DefaultValue: always
+   * - Constraint: (always,onChange)
+   */
+  std::string m_publishMode;
+
+  /*!
+   * Changes smaller than this value are not published in onChange mode.
+   * - Name:  publishDeadband
+   * - DefaultValue: 0.0
+   */
+  double m_publishDeadband;
+
+  /*!
+   * Period [sec] to publish unchanged data in onChange mode (0 = never).
+   * - Name:  publishKeepAlive
+   * - DefaultValue: 1.0
+   */
+  double m_publishKeepAlive;
+
+  // </rtc-template>
+
+  // DataInPort declaration
+  // <rtc-template block="inport_declare">
+  RTC::TimedDoubleSeq m_targetForce;
+  /*!
+   * Packed target forces of all robots (robot order, then joint order)
+   */
+  InPort<RTC::TimedDoubleSeq> m_targetForceIn;
+  RTC::TimedDoubleSeq m_targetVelocity;
+  /*!
+   */
+  InPort<RTC::TimedDoubleSeq> m_targetVelocityIn;
+  RTC::TimedDoubleSeq m_targetPosition;
+  /*!
+   */
+  InPort<RTC::TimedDoubleSeq> m_targetPositionIn;
+  
+  // </rtc-template>
+
+
+  // DataOutPort declaration
+  // <rtc-template block="outport_declare">
+  RTC::TimedDoubleSeq m_currentForce;
+  /*!
+   * Packed current forces of all robots (robot order, then joint order)
+   */
+  OutPort<RTC::TimedDoubleSeq> m_currentForceOut;
+  RTC::TimedDoubleSeq m_currentVelocity;
+  /*!
+   */
+  OutPort<RTC::TimedDoubleSeq> m_currentVelocityOut;
+  RTC::TimedDoubleSeq m_currentPosition;
+  /*!
+   */
+  OutPort<RTC::TimedDoubleSeq> m_currentPositionOut;
+  RTC::TimedLongSeq m_jointCounts;
+  /*!
+   * Number of joints of each robot in the packed sequences, written
+   * with every state write and the same timestamp
+   */
+  OutPort<RTC::TimedLongSeq> m_jointCountsOut;
+  
+  // </rtc-template>
+
+  // CORBA Port declaration
+  // <rtc-template block="corbaport_declare">
+  
+  // </rtc-template>
+
+  // Service declaration
+  // <rtc-template block="service_declare">
+  
+  // </rtc-template>
+
+  // Consumer declaration
+  // <rtc-template block="consumer_declare">
+  
+  // </rtc-template>
+
+ private:
+  // <rtc-template block="private_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="private_operation">
+  
+  // </rtc-template>
+
+  std::vector<std::string> m_robotNames;
+  JointHandleList m_jointHandle;
+  double m_lastTickTime;
+  PublishFilter m_positionFilter;
+  PublishFilter m_velocityFilter;
+  PublishFilter m_forceFilter;
+  ErrorCounter m_sizeError;
+  ErrorCounter m_jointError;
+  AllocationCheck m_allocationCheck;
+
+  bool checkLength(const RTC::TimedDoubleSeq& data);
+};
+
+
+extern "C"
+{
+  DLL_EXPORT void RobotFleetRTCInit(RTC::Manager* manager);
+};
+
+#endif // ROBOTFLEETRTC_H
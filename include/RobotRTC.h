@@ -21,6 +21,11 @@
 
 #include <stdint.h>
 
+#include "StepListener.h"
+#include "JointSampleRing.h"
+#include "PublishFilter.h"
+#include "ErrorCounter.h"
+#include "AllocationCheck.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -54,13 +59,40 @@ public:
 
 typedef std::vector<int32_t> JointHandleList;
 
+/**
+ * @brief Joint handle lists compiled from the joint name configurations.
+ *
+ * The source strings are kept so that the plan is rebuilt only when
+ * the configuration actually changes.
+ */
+class JointIndexPlan {
+ public:
+  bool parsed;
+  std::string controlledSource;
+  std::string observedSource;
+  JointHandleList controlled;
+  JointHandleList observed;
+
+ public:
+ JointIndexPlan() : parsed(false) {}
+
+  bool isCompiledFrom(const std::string& controlledNames, const std::string& observedNames) const {
+    return parsed && controlledSource == controlledNames && observedSource == observedNames;
+  }
+};
+
+/**
+ * @brief split comma separated list like "[ joint1, joint2 ]" into trimmed tokens
+ */
+void splitList(const std::string& str, std::vector<std::string>& tokens);
+
 /*!
  * @class RobotRTC
  * @brief Simulator Robot RTC
  *
  */
 class RobotRTC
-  : public RTC::DataFlowComponentBase
+  : public RTC::DataFlowComponentBase, public StepListener
 {
  public:
   /*!
@@ -234,6 +266,15 @@ class RobotRTC
    */
   // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
 
+  /***
+   *
+   * Record the observed joints on every physics step (oversampling mode)
+   *
+   * @param time simulation time
+   * @param timeStep simulation time step
+   */
+  virtual void onSimulationStep(const float time, const float timeStep);
+
 
  protected:
   // <rtc-template block="protected_attribute">
@@ -267,6 +308,44 @@ class RobotRTC
    */
   std::string m_observedJointNames;
 
+  /*!
+   * Physics-rate sampling of the observed joints.
+   * - Name:  oversampling
+   * - DefaultValue: off
+   * - Constraint: (off,average,batch)
+   */
+  std::string m_oversampling;
+
+  /*!
+   * Number of physics steps the sample ring can hold between ticks.
+   * - Name:  oversamplingBuffer
+   * - DefaultValue: 100
+   * - Constraint: 1<=x
+   */
+  int m_oversamplingBuffer;
+
+  /*!
+   * Publish every tick (always) or only when the data changes (onChange).
+   * - Name:  publishMode
+   * - DefaultValue: always
+   * - Constraint: (always,onChange)
+   */
+  std::string m_publishMode;
+
+  /*!
+   * Changes smaller than this value are not published in onChange mode.
+   * - Name:  publishDeadband
+   * - DefaultValue: 0.0
+   */
+  double m_publishDeadband;
+
+  /*!
+   * Period [sec] to publish unchanged data in onChange mode (0 = never).
+   * - Name:  publishKeepAlive
+   * - DefaultValue: 1.0
+   */
+  double m_publishKeepAlive;
+
   // </rtc-template>
 
   // DataInPort declaration
@@ -301,6 +380,19 @@ class RobotRTC
   /*!
    */
   OutPort<RTC::TimedDoubleSeq> m_currentPositionOut;
+  RTC::TimedDoubleSeq m_forceSamples;
+  /*!
+   * All samples since the last tick in batch mode (row-major, sample x joint)
+   */
+  OutPort<RTC::TimedDoubleSeq> m_forceSamplesOut;
+  RTC::TimedDoubleSeq m_velocitySamples;
+  /*!
+   */
+  OutPort<RTC::TimedDoubleSeq> m_velocitySamplesOut;
+  RTC::TimedDoubleSeq m_positionSamples;
+  /*!
+   */
+  OutPort<RTC::TimedDoubleSeq> m_positionSamplesOut;
   
   // </rtc-template>
 
@@ -330,8 +422,34 @@ class RobotRTC
 
   int m_objectHandle;
   JointHandleMap m_jointHandleMap;
-  JointHandleList m_controlledJointHandle;
-  JointHandleList m_observedJointHandle;
+  JointIndexPlan m_jointPlan;
+  JointIndexPlan m_rejectedPlan;
+
+  enum {
+    OVERSAMPLING_OFF = 0,
+    OVERSAMPLING_AVERAGE = 1,
+    OVERSAMPLING_BATCH = 2,
+  };
+  int m_oversamplingMode;
+  uint32_t m_sampleCapacity;
+  JointSampleRing m_sampleRing;
+  PublishFilter m_positionFilter;
+  PublishFilter m_velocityFilter;
+  PublishFilter m_forceFilter;
+  std::vector<float> m_lastSamplePosition;
+  bool m_lastSampleValid;
+  double m_lastTickTime;
+  ErrorCounter m_sizeError;
+  ErrorCounter m_jointError;
+  AllocationCheck m_allocationCheck;
+
+  bool resolveJointNames(const std::string& names, JointHandleList& handles);
+  bool compileJointPlan(JointIndexPlan& plan);
+  void setupObservedJoints();
+  void reconfigureJoints();
+  bool checkLength(const RTC::TimedDoubleSeq& data);
+  RTC::ReturnCode_t readObservedJoints(const double time);
+  void publishSamples();
 };
 
 
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "Tasks.h"
+
+/**
+ * @brief Interface of objects which are notified on every simulation step.
+ *
+ * Listeners are called from the V-REP main thread before the RTCs are ticked,
+ * so they see every physics step even if their RTC runs slower.
+ */
+class StepListener {
+ public:
+  virtual ~StepListener() {}
+
+  virtual void onSimulationStep(const float time, const float timeStep) = 0;
+};
+
+
+/**
+ * @brief Step Listener Container Class.
+ */
+class StepListenerList : public std::vector<StepListener*> {
+ private:
+  coil::Mutex m_m;
+ public:
+  StepListenerList() {}
+  ~StepListenerList() {}
+
+ public:
+  void add(StepListener* l) {
+    MutexBinder b(m_m);
+    if (std::find(begin(), end(), l) == end()) {
+      push_back(l);
+    }
+  }
+
+  void remove(StepListener* l) {
+    MutexBinder b(m_m);
+    StepListenerList::iterator it = std::find(begin(), end(), l);
+    if (it != end()) {
+      erase(it);
+    }
+  }
+
+  void notify(const float time, const float timeStep) {
+    MutexBinder b(m_m);
+    for(StepListenerList::iterator it = begin();it != end();++it) {
+      (*it)->onSimulationStep(time, timeStep);
+    }
+  }
+};
+
+extern StepListenerList stepListeners;
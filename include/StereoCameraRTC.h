@@ -0,0 +1,385 @@
+// -*- C++ -*-
+/*!
+ * @file  StereoCameraRTC.h
+ * @brief Simulator Stereo Camera RTC
+ * @date  $Date$
+ *
+ * $Id$
+ */
+
+#ifndef STEREOCAMERARTC_H
+#define STEREOCAMERARTC_H
+
+#include <rtm/idl/BasicDataTypeSkel.h>
+#include <rtm/idl/ExtendedDataTypesSkel.h>
+#include <rtm/idl/InterfaceDataTypesSkel.h>
+#include <rtm/Manager.h>
+#include <rtm/DataFlowComponentBase.h>
+#include <rtm/CorbaPort.h>
+#include <rtm/DataInPort.h>
+#include <rtm/DataOutPort.h>
+
+#include <stdint.h>
+
+#include "ErrorCounter.h"
+#include "AllocationCheck.h"
+#include "ImageConversion.h"
+#include "WorkerPool.h"
+#include "StereoRectification.h"
+
+// Service implementation headers
+// <rtc-template block="service_impl_h">
+
+// </rtc-template>
+
+// Service Consumer stub headers
+// <rtc-template block="consumer_stub_h">
+
+// </rtc-template>
+
+#include <string>
+#include <vector>
+
+using namespace RTC;
+
+/*!
+ * @brief Converts and rectifies the left (index 0) and right (index 1)
+ * images on the WorkerPool.
+ */
+class StereoConversion : public ParallelTask {
+ public:
+  ImageConverter converters[2];
+  RectificationMap maps[2];
+  std::vector<uint8_t> scratch[2];
+  const float* images[2];
+  const uint8_t* charImages[2];
+  bool byteSource;  // charImages of this tick, else images
+  uint8_t* dst[2];
+
+  virtual void execute(const int index) {
+    bool rectify = !maps[index].identity();
+    uint8_t* bgr = rectify ? &scratch[index][0] : dst[index];
+    if (byteSource) {
+      converters[index].convert(charImages[index], bgr);
+    } else {
+      converters[index].convert(images[index], bgr);
+    }
+    if (rectify) {
+      maps[index].remap(bgr, dst[index]);
+    }
+  }
+};
+
+/*!
+ * @class StereoCameraRTC
+ * @brief Simulator Stereo Camera RTC
+ *
+ */
+class StereoCameraRTC
+  : public RTC::DataFlowComponentBase
+{
+ public:
+  /*!
+   * @brief constructor
+   * @param manager Maneger Object
+   */
+  StereoCameraRTC(RTC::Manager* manager);
+
+  /*!
+   * @brief destructor
+   */
+  ~StereoCameraRTC();
+
+  // <rtc-template block="public_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="public_operation">
+  
+  // </rtc-template>
+
+  /***
+   *
+   * The initialize action (on CREATED->ALIVE transition)
+   * formaer rtc_init_entry() 
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onInitialize();
+
+  /***
+   *
+   * The finalize action (on ALIVE->END transition)
+   * formaer rtc_exiting_entry()
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onFinalize();
+
+  /***
+   *
+   * The startup action when ExecutionContext startup
+   * former rtc_starting_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onStartup(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The shutdown action when ExecutionContext stop
+   * former rtc_stopping_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onShutdown(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The activated action (Active state entry action)
+   * former rtc_active_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onActivated(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The deactivated action (Active state exit action)
+   * former rtc_active_exit()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onDeactivated(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The execution action that is invoked periodically
+   * former rtc_active_do()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onExecute(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The aborting action when main logic error occurred.
+   * former rtc_aborting_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onAborting(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The error action in ERROR state
+   * former rtc_error_do()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onError(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The reset action that is invoked resetting
+   * This is same but different the former rtc_init_entry()
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onReset(RTC::UniqueId ec_id);
+  
+  /***
+   *
+   * The state update action that is invoked after onExecute() action
+   * no corresponding operation exists in OpenRTm-aist-0.2.0
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onStateUpdate(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The action that is invoked when execution context's rate is changed
+   * no corresponding operation exists in OpenRTm-aist-0.2.0
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
+
+
+ protected:
+  // <rtc-template block="protected_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="protected_operation">
+  
+  // </rtc-template>
+
+  // Configuration variable declaration
+  // <rtc-template block="config_declare">
+  /*!
+   * 
+   * - Name:  objectName
+   * - DefaultValue: none
+   */
+  std::string m_objectName;
+
+  /*!
+   * Rotate both images to a common orientation perpendicular to the
+   * baseline. The maps are computed when the RTC is activated.
+   * - Name:  rectify
+   * - DefaultValue: on
+   * - Constraint: (on,off)
+   */
+  std::string m_rectify;
+
+  /*!
+   * Image fetched from V-REP. "byte" uses the unsigned char image and
+   * skips the float conversion.
+   * - Name:  imageSource
+   * - DefaultValue: float
+   * - Constraint: (float,byte)
+   */
+  std::string m_imageSource;
+
+  /*!
+   * onDemand switches the vision sensors to explicit handling and renders
+   * them only on the ticks which publish. always leaves the
+   * handling set in the scene, scripts reading the sensor keep working.
+   * While an RTC with always reads the same sensor, it is rendered on
+   * every step.
+   * - Name:  renderMode
+   * - DefaultValue: always
+   * - Constraint: (always,onDemand)
+   */
+  std::string m_renderMode;
+
+  /*!
+   * 1 converts the right image on a worker thread while the simulation
+   * thread converts the left one, 0 converts both on the simulation thread.
+   * - Name:  workerThreads
+   * - DefaultValue: 1
+   * - Constraint: 0<=x<=1
+   */
+  int m_workerThreads;
+
+  /*!
+   * Publish every decimation-th tick.
+   * - Name:  decimation
+   * - DefaultValue: 1
+   * - Constraint: 1<=x
+   */
+  int m_decimation;
+
+  // </rtc-template>
+
+  // DataInPort declaration
+  // <rtc-template block="inport_declare">
+  // </rtc-template>
+
+
+  // DataOutPort declaration
+  // <rtc-template block="outport_declare">
+  RTC::CameraImage m_left;
+  /*!
+   * Left image, same timestamp as right
+   */
+  OutPort<RTC::CameraImage> m_leftOut;
+  RTC::CameraImage m_right;
+  /*!
+   */
+  OutPort<RTC::CameraImage> m_rightOut;
+  
+  // </rtc-template>
+
+  // CORBA Port declaration
+  // <rtc-template block="corbaport_declare">
+  
+  // </rtc-template>
+
+  // Service declaration
+  // <rtc-template block="service_declare">
+  
+  // </rtc-template>
+
+  // Consumer declaration
+  // <rtc-template block="consumer_declare">
+  
+  // </rtc-template>
+
+ private:
+  // <rtc-template block="private_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="private_operation">
+  
+  // </rtc-template>
+
+  std::vector<std::string> m_objectNames;
+  std::vector<int> m_objectHandles;
+  std::vector<bool> m_renderOnDemand;
+  int m_sensorWidth;
+  int m_sensorHeight;
+  uint32_t m_tick;
+  uint32_t m_tickPeriod;  // decimation checked at activation
+  ErrorCounter m_imageError;
+  AllocationCheck m_allocationCheck;
+  WorkerPool m_workerPool;
+  StereoConversion m_conversion;
+
+  void requestRenderings();
+};
+
+
+extern "C"
+{
+  DLL_EXPORT void StereoCameraRTCInit(RTC::Manager* manager);
+};
+
+#endif // STEREOCAMERARTC_H
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Focal length in pixels of a V-REP perspective vision sensor.
+ *
+ * V-REP applies the perspective angle to the larger image dimension.
+ */
+float visionSensorFocalLength(const int width, const int height, const float perspectiveAngle);
+
+/**
+ * @brief Common orientation of a rectified stereo pair.
+ *
+ * The image right axis (sensor -x) points along the baseline from the left
+ * to the right sensor, the view axis (sensor z) is the mean of both view
+ * axes made orthogonal to the baseline.
+ *
+ * @param left, right 12 floats of simGetObjectMatrix (world frame)
+ * @param rotation receives the rectified sensor frame in the same layout
+ * (3x4 row major, the position column is left untouched)
+ * @return false if the right sensor is not on the image right of the left one.
+ */
+bool stereoRectifiedRotation(const float* left, const float* right, float* rotation);
+
+/**
+ * @brief Pixel lookup table from a rectified image to a sensor image.
+ *
+ * Both images have the same resolution and focal length, only the
+ * orientation differs. The table is built in configure() with nearest
+ * neighbour sampling, so remap() is a single gather per pixel. Pixels
+ * outside the sensor image are black.
+ */
+class RectificationMap {
+ private:
+  int m_width;
+  int m_height;
+  bool m_identity;
+  std::vector<int32_t> m_map;
+
+ public:
+  RectificationMap() : m_width(0), m_height(0), m_identity(true) {}
+  ~RectificationMap() {}
+
+ public:
+  /**
+   * @param sensor simGetObjectMatrix of the sensor
+   * @param rectified output of stereoRectifiedRotation
+   */
+  void configure(const int width, const int height, const float focalLength,
+		 const float* sensor, const float* rectified);
+
+  /**
+   * @return true if the rectified image is the sensor image, remap() is not needed.
+   */
+  bool identity() const { return m_identity; }
+
+  /**
+   * @param src, dst width*height*3 bytes BGR (top row first), must not overlap.
+   */
+  void remap(const uint8_t* src, uint8_t* dst) const;
+};
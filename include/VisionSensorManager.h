@@ -0,0 +1,149 @@
+#pragma once
+
+#include <map>
+#include <stdint.h>
+#include <v_repLib.h>
+#include <coil/Mutex.h>
+#include "Tasks.h"
+
+/**
+ * @brief Vision sensors rendered on demand by the RTCs which read them.
+ *
+ * Every RTC reading a sensor registers with acquire(), telling whether it
+ * renders the sensor on demand. While all users are on demand the sensor
+ * is switched to explicit handling, so the main script no longer renders
+ * it on every step; as soon as one user renders always, the previous flag
+ * is restored and the sensor is rendered on every step for all of them.
+ *
+ * On-demand users request() a rendering for their next tick from onExecute.
+ * The renderings are done by renderRequested() on the V-REP main thread,
+ * before the execution contexts are ticked, at most once per simulation
+ * time, so several RTCs on the same sensor share one rendering. With an
+ * execution context slower than the simulation step the image is of the
+ * first step after the request.
+ *
+ * The image and depth buffers are fetched from V-REP at most once per
+ * simulation time and handed out as read-only views, valid until the
+ * buffer is fetched for a later time or clear() is called. Callers must
+ * not release them.
+ */
+class VisionSensorManager {
+ private:
+  struct Sensor {
+    int users; // on demand
+    int alwaysUsers;
+    int savedFlags;
+    bool explicitHandling;
+    bool requested;
+    bool failed;
+    uint32_t renders;
+    float firstRender;
+    float lastRender;
+  };
+  template<class T>
+  struct Buffer {
+    T* data;
+    float time;
+    int resolution[2];
+  Buffer() : data(NULL), time(-1) { resolution[0] = resolution[1] = 0; }
+
+    void release() {
+      if (data != NULL) {
+	simReleaseBuffer((simChar*)data);
+      }
+      data = NULL;
+      time = -1;
+    }
+  };
+  struct Cache {
+    Buffer<simFloat> image;
+    Buffer<simUChar> charImage;
+    Buffer<simFloat> depth;
+  };
+  coil::Mutex m_m;
+  std::map<int, Sensor> m_sensors;
+  std::map<int, Cache> m_caches;
+  uint32_t m_fetches;
+  uint32_t m_hits;
+
+  /**
+   * Release the buffers of the sensor. The cache entry is kept, so the
+   * next fetch does not allocate a map node.
+   */
+  void invalidate(const int handle);
+
+  /**
+   * Switch explicit handling on while all users are on demand, off otherwise.
+   */
+  bool updateHandling(const int handle, Sensor& s);
+
+ public:
+  VisionSensorManager() : m_fetches(0), m_hits(0) {}
+  ~VisionSensorManager() {}
+
+ public:
+  /**
+   * Register a user of the sensor.
+   * @return true if the user renders on demand, false if it asked for
+   * always or explicit handling failed; it then counts as always user.
+   */
+  bool acquire(const int handle, const bool onDemand);
+
+  /**
+   * @param onDemand the result of acquire()
+   */
+  void release(const int handle, const bool onDemand);
+
+  /**
+   * Ask for a rendering before the next tick. Does nothing while the
+   * sensor is rendered on every step.
+   */
+  void request(const int handle);
+
+  /**
+   * Render the requested sensors unless already rendered at this time.
+   * Called on the V-REP main thread before the RTCs are ticked.
+   */
+  void renderRequested(const float time);
+
+  /**
+   * @return false if the last on-demand rendering of the sensor failed.
+   */
+  bool rendered(const int handle);
+
+  /**
+   * RGB float image (simGetVisionSensorImage) of the given time.
+   */
+  const float* image(const int handle, const float time);
+
+  /**
+   * RGB byte image (simGetVisionSensorCharImage) of the given time.
+   * @param resolution receives width and height
+   */
+  const uint8_t* charImage(const int handle, const float time, int* resolution);
+
+  /**
+   * Depth buffer (simGetVisionSensorDepthBuffer) of the given time.
+   */
+  const float* depthBuffer(const int handle, const float time);
+
+  /**
+   * Release all cached buffers and reset the fetch counters.
+   */
+  void clear();
+
+  uint32_t fetchCount() const { return m_fetches; }
+  uint32_t hitCount() const { return m_hits; }
+
+  /**
+   * Number of renderings since the first user acquired the sensor.
+   */
+  uint32_t renderCount(const int handle);
+
+  /**
+   * Renderings per second of simulation time.
+   */
+  float renderRate(const int handle);
+};
+
+extern VisionSensorManager visionSensors;
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Voxel grid filter which replaces the points of every occupied
+ * voxel by their centroid and mean colour.
+ *
+ * Voxels are found through an open addressing hash table. The table and
+ * the voxel arena are allocated in configure() for the largest cloud, so
+ * filter() does not allocate.
+ */
+class VoxelGrid {
+ private:
+  struct Voxel {
+    int32_t key[3];
+    float sum[3];
+    uint32_t colour[3];
+    uint32_t count;
+  };
+  float m_size;
+  std::vector<Voxel> m_voxels;
+  std::vector<int32_t> m_table;
+  uint32_t m_mask;
+
+ public:
+  VoxelGrid() : m_size(0), m_mask(0) {}
+  ~VoxelGrid() {}
+
+ public:
+  /**
+   * @param size voxel edge [m], 0 disables the filter
+   */
+  void configure(const int maxPoints, const float size);
+
+  float size() const { return m_size; }
+
+  /**
+   * @param points count points of 4 floats (x, y, z, uint32 0x00RRGGBB)
+   * @param out receives the filtered points in the same layout, may be points
+   * @return number of points in out
+   */
+  int filter(const float* points, const int count, float* out);
+};
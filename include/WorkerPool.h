@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <coil/Task.h>
+#include <coil/Mutex.h>
+#include <coil/Condition.h>
+#include "Tasks.h"
+
+/**
+ * @brief Work item of WorkerPool::run, called once for every index.
+ */
+class ParallelTask {
+ public:
+  virtual ~ParallelTask() {}
+
+  virtual void execute(const int index) = 0;
+};
+
+
+/**
+ * @brief Persistent threads for a parallel for loop.
+ *
+ * run() hands the indices 0..count-1 to the worker threads and to the
+ * calling thread and returns when all of them are done. The threads are
+ * created in start() and sleep between the runs.
+ */
+class WorkerPool {
+ private:
+  class Worker : public coil::Task {
+   private:
+    WorkerPool* m_pool;
+   public:
+    Worker(WorkerPool* pool) : m_pool(pool) {}
+    virtual int svc() { m_pool->work(); return 0; }
+  };
+
+  typedef coil::Condition<coil::Mutex> Condition;
+  coil::Mutex m_m;
+  Condition m_started;
+  Condition m_finished;
+  std::vector<Worker*> m_workers;
+  ParallelTask* m_task;
+  int m_count;
+  int m_next;
+  int m_pending;
+  uint32_t m_generation;
+  bool m_running;
+
+  void work();
+  void executeAll();
+
+ public:
+  WorkerPool();
+  ~WorkerPool();
+
+ public:
+  /**
+   * @param threads number of threads besides the caller of run()
+   */
+  void start(const int threads);
+  void stop();
+
+  int threads() const { return (int)m_workers.size(); }
+
+  void run(ParallelTask& task, const int count);
+};
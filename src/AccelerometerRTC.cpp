@@ -35,11 +35,18 @@ static const char* accelerometerrtc_spec[] =
     //"conf.default.minAccelerometer", "0.3",
     //    "conf.default.objectHandle", "-1",
     //"conf.default.activeJointNames", "[]",
+    "conf.default.publishMode", "always",
+    "conf.default.publishDeadband", "0.0",
+    "conf.default.publishKeepAlive", "1.0",
     // Widget
     "conf.__widget__.objectName", "text",
     //"conf.__widget__.objectHandle", "text",
     "conf.__widget__.activeJointNames", "text",
+    "conf.__widget__.publishMode", "radio",
+    "conf.__widget__.publishDeadband", "text",
+    "conf.__widget__.publishKeepAlive", "text",
     // Constraints
+    "conf.__constraints__.publishMode", "(always,onChange)",
     ""
   };
 // </rtc-template>
@@ -51,8 +58,9 @@ static const char* accelerometerrtc_spec[] =
 AccelerometerRTC::AccelerometerRTC(RTC::Manager* manager)
     // <rtc-template block="initializer">
   : RTC::DataFlowComponentBase(manager),
-    m_accelOut("accel", m_accel)
+    m_accelOut("accel", m_accel),
     // </rtc-template>
+    m_allocationCheck("AccelerometerRTC")
 {
 }
 
@@ -85,6 +93,9 @@ RTC::ReturnCode_t AccelerometerRTC::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("objectName", m_objectName, "none");
+  bindParameter("publishMode", m_publishMode, "always");
+  bindParameter("publishDeadband", m_publishDeadband, "0.0");
+  bindParameter("publishKeepAlive", m_publishKeepAlive, "1.0");
   //bindParameter("geometry_offset", m_offsetStr, "0,0,0,0,0,0");
   //bindParameter("maxAccelerometer", m_maxAccelerometer, "30.0");
   //bindParameter("minAccelerometer", m_minAccelerometer, "0.3");
@@ -135,11 +146,17 @@ RTC::ReturnCode_t AccelerometerRTC::onShutdown(RTC::UniqueId ec_id)
 RTC::ReturnCode_t AccelerometerRTC::onActivated(RTC::UniqueId ec_id)
 {
   std::cout << " - Activating AccelerometerRTC: " << m_objectName << std::endl;
+  m_publishFilter.configure(m_publishMode, m_publishDeadband, m_publishKeepAlive);
   return RTC::RTC_OK;
 }
 
 RTC::ReturnCode_t AccelerometerRTC::onDeactivated(RTC::UniqueId ec_id)
 {
+  if (m_sizeError.total() > 0) {
+    std::cout << "[AccelerometerRTC] " << m_sizeError.total() << " messages with invalid data size." << std::endl;
+  }
+  m_sizeError.reset();
+  m_allocationCheck.reset();
   return RTC::RTC_OK;
 }
 
@@ -152,6 +169,7 @@ union float_byte {
 
 RTC::ReturnCode_t AccelerometerRTC::onExecute(RTC::UniqueId ec_id)
 {
+  m_allocationCheck.begin();
   simInt bufSize;
   simChar* pBuffer = simTubeRead(m_tubeHandle, &bufSize);
   if (pBuffer == NULL) {
@@ -160,7 +178,10 @@ RTC::ReturnCode_t AccelerometerRTC::onExecute(RTC::UniqueId ec_id)
   float_byte buffer;
   int data_size = bufSize / 4;
   if (data_size != 3) {
-    std::cout << "[AccelerometerRTC] Invalid data size (" << data_size << "!=3)" << std::endl;
+    if (m_sizeError.raise(simGetSimulationTime())) {
+      std::cout << "[AccelerometerRTC] Invalid data size (" << data_size << "!=3, " << m_sizeError.take() << " times)" << std::endl;
+    }
+    simReleaseBuffer((simChar*)pBuffer);
     return RTC::RTC_OK;
   }
 
@@ -180,7 +201,11 @@ RTC::ReturnCode_t AccelerometerRTC::onExecute(RTC::UniqueId ec_id)
   m_accel.data.ax = x[0];
   m_accel.data.ay = x[1];
   m_accel.data.az = x[2];
-  m_accelOut.write();
+  double values[3] = {x[0], x[1], x[2]};
+  m_allocationCheck.end(time);
+  if (m_publishFilter.check(values, 3, time)) {
+    m_accelOut.write();
+  }
   simReleaseBuffer((simChar*)pBuffer);
   
   return RTC::RTC_OK;
@@ -0,0 +1,59 @@
+#include "AllocationCheck.h"
+
+unsigned long AllocationCheck::s_totalViolations = 0;
+
+#ifdef RTC_ALLOCATION_CHECK
+#include <new>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#if __cplusplus >= 201103L
+#define NEW_THROW
+#define DELETE_THROW noexcept
+#else
+#define NEW_THROW throw(std::bad_alloc)
+#define DELETE_THROW throw()
+#endif
+
+static THREAD_LOCAL unsigned long allocation_count = 0;
+
+// Replacement of the global allocation functions. The makefile links the
+// checking build with -Bsymbolic-functions so that the plugin's own calls
+// bind here; allocations inside V-REP or OpenRTM libraries are not counted.
+void* operator new(size_t size) NEW_THROW {
+  allocation_count++;
+  void* p = malloc(size ? size : 1);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size) NEW_THROW {
+  return operator new(size);
+}
+
+void operator delete(void* p) DELETE_THROW {
+  free(p);
+}
+
+void operator delete[](void* p) DELETE_THROW {
+  free(p);
+}
+
+unsigned long allocationCount() {
+  return allocation_count;
+}
+
+#else
+
+unsigned long allocationCount() {
+  return 0;
+}
+
+#endif
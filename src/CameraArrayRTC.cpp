@@ -0,0 +1,369 @@
+// -*- C++ -*-
+/*!
+ * @file  CameraArrayRTC.cpp
+ * @brief Simulator Camera Array RTC for VREP simulator
+ *
+ * One component publishes the images of many vision sensors in one
+ * CameraImage. All the sensors are rendered and fetched on the same step,
+ * the images are converted into their tiles in parallel.
+ */
+
+#include "CameraArrayRTC.h"
+#include "VisionSensorManager.h"
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <v_repLib.h>
+// Module specification
+// <rtc-template block="module_spec">
+static const char* cameraarrayrtc_spec[] =
+  {
+    "implementation_id", "CameraArrayRTC",
+    "type_name",         "CameraArrayRTC",
+    "description",       "Simulator Camera Array RTC",
+    "version",           "1.0.0",
+    "vendor",            "ysuga_net",
+    "category",          "Simulator",
+    "activity_type",     "PERIODIC",
+    "kind",              "DataFlowComponent",
+    "max_instance",      "1",
+    "language",          "C++",
+    "lang_type",         "compile",
+    // Configuration variables
+    "conf.default.objectName", "none",
+    "conf.default.layout", "tiled",
+    "conf.default.columns", "0",
+    "conf.default.imageSource", "float",
+    "conf.default.renderMode", "always",
+    "conf.default.workerThreads", "2",
+    "conf.default.decimation", "1",
+    // Widget
+    "conf.__widget__.objectName", "text",
+    "conf.__widget__.layout", "radio",
+    "conf.__widget__.columns", "text",
+    "conf.__widget__.imageSource", "radio",
+    "conf.__widget__.renderMode", "radio",
+    "conf.__widget__.workerThreads", "text",
+    "conf.__widget__.decimation", "text",
+    // Constraints
+    "conf.__constraints__.layout", "(tiled,batch)",
+    "conf.__constraints__.columns", "0<=x",
+    "conf.__constraints__.imageSource", "(float,byte)",
+    "conf.__constraints__.renderMode", "(always,onDemand)",
+    "conf.__constraints__.workerThreads", "0<=x",
+    "conf.__constraints__.decimation", "1<=x",
+    ""
+  };
+// </rtc-template>
+
+/*!
+ * @brief constructor
+ * @param manager Maneger Object
+ */
+CameraArrayRTC::CameraArrayRTC(RTC::Manager* manager)
+    // <rtc-template block="initializer">
+  : RTC::DataFlowComponentBase(manager),
+    m_imageOut("image", m_image),
+    // </rtc-template>
+    m_allocationCheck("CameraArrayRTC")
+{
+}
+
+/*!
+ * @brief destructor
+ */
+CameraArrayRTC::~CameraArrayRTC()
+{
+}
+
+
+
+RTC::ReturnCode_t CameraArrayRTC::onInitialize()
+{
+  // Registration: InPort/OutPort/Service
+  // <rtc-template block="registration">
+  // Set InPort buffers
+
+  // Set OutPort buffer
+  addOutPort("image", m_imageOut);
+
+  // Set service provider to Ports
+  
+  // Set service consumers to Ports
+  
+  // Set CORBA Service Ports
+  
+  // </rtc-template>
+
+  // <rtc-template block="bind_config">
+  // Bind variables and configuration variable
+  bindParameter("objectName", m_objectName, "none");
+  bindParameter("layout", m_layout, "tiled");
+  bindParameter("columns", m_columns, "0");
+  bindParameter("imageSource", m_imageSource, "float");
+  bindParameter("renderMode", m_renderMode, "always");
+  bindParameter("workerThreads", m_workerThreads, "2");
+  bindParameter("decimation", m_decimation, "1");
+  // </rtc-template>
+
+  std::cout << " - Initializing CameraArrayRTC(" << m_properties.getProperty("conf.default.objectName") << ")" << std::endl;
+
+  std::istringstream names(m_properties.getProperty("conf.__innerparam.objectNames"));
+  std::string token;
+  while(std::getline(names, token, ',')) {
+    m_objectNames.push_back(token);
+  }
+  std::istringstream handles(m_properties.getProperty("conf.__innerparam.objectHandles"));
+  while(std::getline(handles, token, ',')) {
+    m_objectHandles.push_back(atoi(token.c_str()));
+  }
+  std::cout << " -- Cameras = " << m_objectHandles.size() << std::endl;
+  return RTC::RTC_OK;
+}
+
+ 
+RTC::ReturnCode_t CameraArrayRTC::onFinalize()
+{
+  return RTC::RTC_OK;
+}
+
+
+/*
+RTC::ReturnCode_t CameraArrayRTC::onStartup(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t CameraArrayRTC::onShutdown(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+RTC::ReturnCode_t CameraArrayRTC::onActivated(RTC::UniqueId ec_id)
+{
+  std::cout << " - Activating CameraArrayRTC: " << m_objectName << std::endl;
+  const int count = (int)m_objectHandles.size();
+  if (count == 0) {
+    std::cout << " -- No camera." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  // The tiles share one layout, so every camera must have the same resolution.
+  for(int i = 0;i < count;i++) {
+    simInt resolution[2]; // x, y
+    if (simGetVisionSensorResolution(m_objectHandles[i], resolution) < 0) {
+      std::cout << " -- Resolution Request Failed (" << m_objectNames[i] << ")." << std::endl;
+      return RTC::RTC_ERROR;
+    }
+    if (i == 0) {
+      m_sensorWidth = resolution[0];
+      m_sensorHeight = resolution[1];
+    } else if (resolution[0] != m_sensorWidth || resolution[1] != m_sensorHeight) {
+      std::cout << " -- Camera " << m_objectNames[i] << " is " << resolution[0] << "x" << resolution[1]
+		<< ", but " << m_objectNames[0] << " is " << m_sensorWidth << "x" << m_sensorHeight << "." << std::endl;
+      return RTC::RTC_ERROR;
+    }
+  }
+
+  int columns = 1;
+  if (m_layout == "tiled") {
+    columns = m_columns;
+    if (columns <= 0) {
+      columns = (int)ceil(sqrt((double)count));
+    }
+    if (columns > count) {
+      columns = count;
+    }
+  }
+  const int rows = (count + columns - 1) / columns;
+  // CameraImage width and height are unsigned short.
+  const int imageWidth = columns * m_sensorWidth;
+  const int imageHeight = rows * m_sensorHeight;
+  if (imageWidth > 65535 || imageHeight > 65535) {
+    std::cout << " -- Layout " << m_layout << " (" << columns << "x" << rows << ") makes a "
+	      << imageWidth << "x" << imageHeight << " image, larger than 65535 pixels." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  m_tickPeriod = m_decimation > 1 ? m_decimation : 1;
+
+  ImageRegion region = {0, 0, 0, 0};
+  m_conversion.converters.resize(count);
+  m_conversion.images.assign(count, (const float*)NULL);
+  m_conversion.charImages.assign(count, (const uint8_t*)NULL);
+  m_conversion.offsets.resize(count);
+  m_conversion.stride = imageWidth * 3;
+  for(int i = 0;i < count;i++) {
+    m_conversion.converters[i].configure(m_sensorWidth, m_sensorHeight, region, 1);
+    m_conversion.offsets[i] = (i / columns) * m_sensorHeight * m_conversion.stride + (i % columns) * m_sensorWidth * 3;
+  }
+
+  m_image.width = imageWidth;
+  m_image.height = imageHeight;
+  m_image.bpp = 24;
+  m_image.format = "bitmap";
+  m_image.fDiv = 1.0;
+  m_image.pixels.length(m_conversion.stride * imageHeight);
+  // Tiles without a camera stay black.
+  memset(m_image.pixels.get_buffer(), 0, m_image.pixels.length());
+
+  std::cout << " -- Camera Resolution = " << m_sensorWidth << "x" << m_sensorHeight << std::endl;
+  std::cout << " -- Layout = " << m_layout << " (" << columns << "x" << rows << ", "
+	    << m_image.width << "x" << m_image.height << ")" << std::endl;
+  std::cout << " -- Image Source = " << m_imageSource << std::endl;
+  std::cout << " -- Image Conversion Kernel = " << imageConversionKernel() << std::endl;
+  std::cout << " -- Worker Threads = " << m_workerThreads << std::endl;
+
+  m_renderOnDemand.assign(count, false);
+  for(int i = 0;i < count;i++) {
+    m_renderOnDemand[i] = visionSensors.acquire(m_objectHandles[i], m_renderMode == "onDemand");
+    if (m_renderMode == "onDemand" && !m_renderOnDemand[i]) {
+      std::cout << " -- Explicit handling of " << m_objectNames[i] << " failed, rendered on every step." << std::endl;
+    }
+  }
+  requestRenderings();
+  m_workerPool.start(m_workerThreads);
+  m_tick = 0;
+  return RTC::RTC_OK;
+}
+
+
+RTC::ReturnCode_t CameraArrayRTC::onDeactivated(RTC::UniqueId ec_id)
+{
+  m_workerPool.stop();
+  if (m_imageError.total() > 0) {
+    std::cout << " - Deactivated CameraArrayRTC: " << m_imageError.total() << " ticks without image." << std::endl;
+  }
+  for(size_t i = 0;i < m_renderOnDemand.size();i++) {
+    visionSensors.release(m_objectHandles[i], m_renderOnDemand[i]);
+  }
+  m_renderOnDemand.clear();
+  m_imageError.reset();
+  m_allocationCheck.reset();
+  return RTC::RTC_OK;
+}
+
+/*!
+ * Ask for the renderings of the next tick, done on the V-REP main thread.
+ */
+void CameraArrayRTC::requestRenderings()
+{
+  for(size_t i = 0;i < m_renderOnDemand.size();i++) {
+    if (m_renderOnDemand[i]) {
+      visionSensors.request(m_objectHandles[i]);
+    }
+  }
+}
+
+/*!
+ * Fetch every camera at the same simulation time on this thread
+ * (V-REP API), then convert them into their tiles in parallel.
+ */
+RTC::ReturnCode_t CameraArrayRTC::onExecute(RTC::UniqueId ec_id)
+{
+  const bool publish = (m_tick++ % m_tickPeriod == 0);
+  if (m_tick % m_tickPeriod == 0) {
+    requestRenderings();
+  }
+  if (!publish) {
+    return RTC::RTC_OK;
+  }
+  m_allocationCheck.begin();
+  float time = simGetSimulationTime();
+  const int count = (int)m_objectHandles.size();
+  // Chosen once per tick, the pointers of the other source may be released already.
+  m_conversion.byteSource = (m_imageSource == "byte");
+  for(int i = 0;i < count;i++) {
+    if (m_renderOnDemand[i] && !visionSensors.rendered(m_objectHandles[i])) {
+      if (m_imageError.raise(time)) {
+	std::cout << " -- ERROR, CameraArrayRTC::Rendering " << m_objectNames[i] << " failed (" << m_imageError.take() << " times)" << std::endl;
+      }
+      return RTC::RTC_OK;
+    }
+    bool ok;
+    if (m_conversion.byteSource) {
+      int resolution[2];
+      m_conversion.images[i] = NULL;
+      m_conversion.charImages[i] = visionSensors.charImage(m_objectHandles[i], time, resolution);
+      ok = m_conversion.charImages[i] != NULL && resolution[0] == m_sensorWidth && resolution[1] == m_sensorHeight;
+    } else {
+      m_conversion.charImages[i] = NULL;
+      m_conversion.images[i] = visionSensors.image(m_objectHandles[i], time);
+      ok = m_conversion.images[i] != NULL;
+    }
+    if (!ok) {
+      if (m_imageError.raise(time)) {
+	std::cout << " -- ERROR, CameraArrayRTC::No image of " << m_objectNames[i] << " (" << m_imageError.take() << " times)" << std::endl;
+      }
+      return RTC::RTC_OK;
+    }
+  }
+
+  m_conversion.dst = m_image.pixels.get_buffer();
+  m_workerPool.run(m_conversion, count);
+
+  long sec = floor(time);
+  long nsec = (time - sec) * 1000*1000*1000;
+  m_image.tm.sec = sec;
+  m_image.tm.nsec = nsec;
+  m_allocationCheck.end(time);
+  m_imageOut.write();
+  return RTC::RTC_OK;
+}
+
+/*
+RTC::ReturnCode_t CameraArrayRTC::onAborting(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t CameraArrayRTC::onError(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t CameraArrayRTC::onReset(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t CameraArrayRTC::onStateUpdate(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t CameraArrayRTC::onRateChanged(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+
+extern "C"
+{
+ 
+  void CameraArrayRTCInit(RTC::Manager* manager)
+  {
+    coil::Properties profile(cameraarrayrtc_spec);
+    manager->registerFactory(profile,
+                             RTC::Create<CameraArrayRTC>,
+                             RTC::Delete<CameraArrayRTC>);
+  }
+  
+};
+
+
@@ -8,10 +8,15 @@
  */
 
 #include "CameraRTC.h"
+#include "ImageConversion.h"
+#include "ImageEncoder.h"
+#include "VisionSensorManager.h"
 #include <string>
 #include <sstream>
 #include <iostream>
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <v_repLib.h>
 // Module specification
 // <rtc-template block="module_spec">
@@ -31,13 +36,47 @@ static const char* camerartc_spec[] =
     // Configuration variables
     "conf.default.objectName", "none",
     "conf.default.offset", "0,0,0,0,0,0",
+    "conf.default.imageSource", "float",
+    "conf.default.format", "bitmap",
+    "conf.default.jpegQuality", "90",
+    "conf.default.pngCompression", "6",
+    "conf.default.encodeQueue", "2",
+    "conf.default.roi", "0,0,0,0",
+    "conf.default.binning", "1",
+    "conf.default.decimation", "1",
+    "conf.default.renderMode", "always",
+    "conf.default.pixelFormat", "bgr8",
+    "conf.default.pyramidLevels", "0",
+    "conf.default.pyramidRates", "1",
     //    "conf.default.objectHandle", "-1",
     //"conf.default.activeJointNames", "[]",
     // Widget
     "conf.__widget__.objectName", "text",
     //"conf.__widget__.objectHandle", "text",
     "conf.__widget__.activeJointNames", "text",
+    "conf.__widget__.imageSource", "radio",
+    "conf.__widget__.format", "radio",
+    "conf.__widget__.jpegQuality", "slider.1",
+    "conf.__widget__.pngCompression", "slider.1",
+    "conf.__widget__.encodeQueue", "text",
+    "conf.__widget__.roi", "text",
+    "conf.__widget__.binning", "radio",
+    "conf.__widget__.decimation", "text",
+    "conf.__widget__.renderMode", "radio",
+    "conf.__widget__.pixelFormat", "radio",
+    "conf.__widget__.pyramidLevels", "text",
+    "conf.__widget__.pyramidRates", "text",
     // Constraints
+    "conf.__constraints__.imageSource", "(float,byte)",
+    "conf.__constraints__.format", "(bitmap,jpeg,png)",
+    "conf.__constraints__.jpegQuality", "0<=x<=100",
+    "conf.__constraints__.pngCompression", "0<=x<=9",
+    "conf.__constraints__.encodeQueue", "1<=x",
+    "conf.__constraints__.binning", "(1,2,4)",
+    "conf.__constraints__.decimation", "1<=x",
+    "conf.__constraints__.renderMode", "(always,onDemand)",
+    "conf.__constraints__.pixelFormat", "(bgr8,mono8,nv12,rgb565)",
+    "conf.__constraints__.pyramidLevels", "0<=x<=4",
     ""
   };
 // </rtc-template>
@@ -49,8 +88,12 @@ static const char* camerartc_spec[] =
 CameraRTC::CameraRTC(RTC::Manager* manager)
     // <rtc-template block="initializer">
   : RTC::DataFlowComponentBase(manager),
-    m_imageOut("image", m_image)
+    m_imageOut("image", m_image),
     // </rtc-template>
+    m_renderOnDemand(false),
+    m_levels(0),
+    m_allocationCheck("CameraRTC"),
+    m_encodeWorker(m_imageOut)
 {
 }
 
@@ -59,6 +102,10 @@ CameraRTC::CameraRTC(RTC::Manager* manager)
  */
 CameraRTC::~CameraRTC()
 {
+  for(size_t i = 0;i < m_levelOut.size();i++) {
+    delete m_levelOut[i];
+    delete m_levelImage[i];
+  }
 }
 
 
@@ -83,8 +130,38 @@ RTC::ReturnCode_t CameraRTC::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("objectName", m_objectName, "none");
+  bindParameter("imageSource", m_imageSource, "float");
+  bindParameter("format", m_format, "bitmap");
+  bindParameter("jpegQuality", m_jpegQuality, "90");
+  bindParameter("pngCompression", m_pngCompression, "6");
+  bindParameter("encodeQueue", m_encodeQueue, "2");
+  bindParameter("roi", m_roiStr, "0,0,0,0");
+  bindParameter("binning", m_binning, "1");
+  bindParameter("decimation", m_decimation, "1");
+  bindParameter("renderMode", m_renderMode, "always");
+  bindParameter("pixelFormat", m_pixelFormatStr, "bgr8");
+  bindParameter("pyramidLevels", m_pyramidLevels, "0");
+  bindParameter("pyramidRates", m_pyramidRatesStr, "1");
   //bindParameter("geometry_offset", m_offsetStr, "0,0,0,0,0,0");
   // </rtc-template>
+
+  // One OutPort per pyramid level, so the number of levels is fixed at creation.
+  // The bound variable is not configured yet in onInitialize.
+  int levels = 0;
+  std::istringstream levelss(m_properties.getProperty("conf.default.pyramidLevels"));
+  levelss >> levels;
+  if (levels < 0 || levels > 4) {
+    levels = 0;
+  }
+  for(int k = 1;k <= levels;k++) {
+    std::ostringstream oss;
+    oss << "imageLevel" << k;
+    RTC::CameraImage* image = new RTC::CameraImage();
+    OutPort<RTC::CameraImage>* port = new OutPort<RTC::CameraImage>(oss.str().c_str(), *image);
+    m_levelImage.push_back(image);
+    m_levelOut.push_back(port);
+    addOutPort(oss.str().c_str(), *port);
+  }
   
   std::cout << " - Initializing Camera: " << m_properties.getProperty("conf.default.objectName") <<  std::endl;
 
@@ -127,47 +204,255 @@ RTC::ReturnCode_t CameraRTC::onActivated(RTC::UniqueId ec_id)
 
   std::cout << " -- Camera Resolution Width = " << resolution[0] << std::endl;
   std::cout << " -- Camera Resolution Height= " << resolution[1] << std::endl;
-  m_image.width = resolution[0];
-  m_image.height = resolution[1];
-  m_image.bpp = 8*3;
-  m_image.format = "bitmap";
+  std::cout << " -- Image Source = " << m_imageSource << std::endl;
+  std::cout << " -- Image Conversion Kernel = " << imageConversionKernel() << std::endl;
+  std::cout << " -- Image Format = " << m_format << std::endl;
+  if (!isImageFormatSupported(m_format)) {
+    std::cout << " -- Image Format " << m_format << " is not supported by this build." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  m_pixelFormat = parsePixelFormat(m_pixelFormatStr);
+  if (m_pixelFormat < 0) {
+    std::cout << " -- Unknown Pixel Format " << m_pixelFormatStr << "." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  if (m_format != "bitmap" && m_pixelFormat != PIXEL_BGR8 && m_pixelFormat != PIXEL_MONO8) {
+    std::cout << " -- Pixel Format " << m_pixelFormatStr << " can not be encoded to " << m_format << "." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  m_sensorWidth = resolution[0];
+  m_sensorHeight = resolution[1];
+
+  ImageRegion roi;
+  if (sscanf(m_roiStr.c_str(), "%d,%d,%d,%d", &roi.x, &roi.y, &roi.width, &roi.height) != 4) {
+    std::cout << " -- ROI must be x,y,width,height (" << m_roiStr << ")." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  m_tickPeriod = m_decimation > 1 ? m_decimation : 1;
+  if (!m_converter.configure(m_sensorWidth, m_sensorHeight, roi, m_binning)) {
+    std::cout << " -- Invalid ROI (" << m_roiStr << ") or binning (" << m_binning << ")." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  m_width = m_converter.width();
+  m_height = m_converter.height();
+  if (m_pixelFormat == PIXEL_NV12 && (m_width % 2 != 0 || m_height % 2 != 0)) {
+    std::cout << " -- nv12 needs even image width and height (" << m_width << "x" << m_height << ")." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  // Only the ports created in onInitialize exist.
+  m_levels = m_pyramidLevels < 0 ? 0 : m_pyramidLevels;
+  if (m_levels > (int)m_levelOut.size()) {
+    m_levels = m_levelOut.size();
+  }
+  if (!m_pyramid.configure(m_width, m_height, m_levels)) {
+    std::cout << " -- Image is too small for " << m_levels << " pyramid levels." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  m_pyramidRates.assign(m_levels, 1);
+  std::istringstream rates(m_pyramidRatesStr);
+  std::string rate;
+  for(int k = 0;k < m_levels && std::getline(rates, rate, ',');k++) {
+    m_pyramidRates[k] = atoi(rate.c_str()) > 0 ? atoi(rate.c_str()) : 1;
+  }
+  for(int k = 1;k <= m_levels;k++) {
+    if (m_pixelFormat == PIXEL_NV12 && (m_pyramid.width(k) % 2 != 0 || m_pyramid.height(k) % 2 != 0)) {
+      std::cout << " -- nv12 needs even image width and height at pyramid level " << k << "." << std::endl;
+      return RTC::RTC_ERROR;
+    }
+    RTC::CameraImage& image = *m_levelImage[k - 1];
+    image.width = m_pyramid.width(k);
+    image.height = m_pyramid.height(k);
+    image.bpp = pixelFormatBpp(m_pixelFormat);
+    image.format = (m_pixelFormat == PIXEL_BGR8 || m_pixelFormat == PIXEL_MONO8) ? "bitmap" : m_pixelFormatStr.c_str();
+    image.fDiv = 1.0;
+    image.pixels.length(pixelFormatSize(m_pixelFormat, image.width, image.height));
+    std::cout << " -- Pyramid Level " << k << " = " << image.width << "x" << image.height
+	      << " (every " << m_pyramidRates[k - 1] << " ticks)" << std::endl;
+  }
+  if (m_pixelFormat != PIXEL_BGR8 || m_levels > 0) {
+    m_bgr.resize(m_width * m_height * 3);
+  }
+  m_tick = 0;
+  std::cout << " -- Image Size = " << m_width << "x" << m_height << " (binning " << m_binning
+	    << ", every " << m_tickPeriod << " ticks)" << std::endl;
+  m_renderOnDemand = visionSensors.acquire(m_objectHandle, m_renderMode == "onDemand");
+  if (m_renderMode == "onDemand" && !m_renderOnDemand) {
+    std::cout << " -- Explicit handling of the vision sensor failed, rendered on every step." << std::endl;
+  }
+  if (m_renderOnDemand) {
+    visionSensors.request(m_objectHandle);
+  }
+  m_image.width = m_width;
+  m_image.height = m_height;
+  m_image.bpp = pixelFormatBpp(m_pixelFormat);
+  if (m_pixelFormat == PIXEL_BGR8 || m_pixelFormat == PIXEL_MONO8) {
+    m_image.format = "bitmap";
+  } else {
+    m_image.format = m_pixelFormatStr.c_str();
+  }
   m_image.fDiv = 1.0;
-  m_image.pixels.length(m_image.width * m_image.height * 3);
+  if (m_format == "bitmap") {
+    m_image.pixels.length(pixelFormatSize(m_pixelFormat, m_width, m_height));
+  } else {
+    m_encodeWorker.configure(m_format, m_jpegQuality, m_pngCompression);
+    m_encodeWorker.start(m_encodeQueue);
+  }
   return RTC::RTC_OK;
 }
 
 
 RTC::ReturnCode_t CameraRTC::onDeactivated(RTC::UniqueId ec_id)
 {
+  if (m_imageError.total() > 0) {
+    std::cout << " - Deactivated CameraRTC: " << m_imageError.total() << " ticks without image." << std::endl;
+  }
+  if (m_encodeWorker.isRunning()) {
+    m_encodeWorker.stop();
+    std::cout << " - Deactivated CameraRTC: " << m_encodeWorker.processed() << " frames encoded, "
+	      << m_encodeWorker.dropped() << " dropped, " << m_encodeWorker.failed() << " failed." << std::endl;
+  }
+  if (m_renderOnDemand) {
+    std::cout << " - Deactivated CameraRTC: " << visionSensors.renderCount(m_objectHandle) << " renderings ("
+	      << visionSensors.renderRate(m_objectHandle) << " per sec)." << std::endl;
+  }
+  visionSensors.release(m_objectHandle, m_renderOnDemand);
+  m_renderOnDemand = false;
+  m_imageError.reset();
+  m_allocationCheck.reset();
   return RTC::RTC_OK;
 }
 
+/*!
+ * Fetch the sensor image and write the region of interest in the pixel
+ * format (top row first) to dst. dst can be NULL when only the pyramid is
+ * published; the BGR base image is kept in m_bgr for the pyramid.
+ */
+bool CameraRTC::convertImage(uint8_t* dst, const float time)
+{
+  uint8_t* bgr = (m_pixelFormat == PIXEL_BGR8 && m_levels == 0) ? dst : &m_bgr[0];
+  // V-REP image is RGB from the bottom row, CameraImage is BGR from the top row.
+  if (m_imageSource == "byte") {
+    int resolution[2];
+    const uint8_t* pBuffer = visionSensors.charImage(m_objectHandle, time, resolution);
+    if (pBuffer == NULL) {
+      if (m_imageError.raise(time)) {
+	std::cout << " -- ERROR, CameraRTC::No image received, but no error (" << m_imageError.take() << " times)" << std::endl;
+      }
+      return false;
+    }
+    if (resolution[0] != m_sensorWidth || resolution[1] != m_sensorHeight) {
+      if (m_imageError.raise(time)) {
+	std::cout << " -- ERROR, CameraRTC::Image resolution changed to " << resolution[0] << "x" << resolution[1] << " (" << m_imageError.take() << " times)" << std::endl;
+      }
+      return false;
+    }
+    m_converter.convert(pBuffer, bgr);
+  } else {
+    const float* pBuffer = visionSensors.image(m_objectHandle, time);
+    if (pBuffer == NULL) {
+      if (m_imageError.raise(time)) {
+	std::cout << " -- ERROR, CameraRTC::No image received, but no error (" << m_imageError.take() << " times)" << std::endl;
+      }
+      return false;
+    }
+    m_converter.convert(pBuffer, bgr);
+  }
+  if (dst != NULL && dst != bgr) {
+    convertBGRImage(bgr, m_width, m_height, m_pixelFormat, dst);
+  }
+  return true;
+}
+
+/*!
+ * Whether the base image or a pyramid level is published at the tick.
+ * topLevel receives the highest published level, 0 for none.
+ */
+bool CameraRTC::publishes(const uint32_t tick, int* topLevel) const
+{
+  *topLevel = 0;
+  for(int k = 1;k <= m_levels;k++) {
+    if (tick % m_pyramidRates[k - 1] == 0) {
+      *topLevel = k;
+    }
+  }
+  return tick % m_tickPeriod == 0 || *topLevel > 0;
+}
+
 RTC::ReturnCode_t CameraRTC::onExecute(RTC::UniqueId ec_id)
 {
-  simFloat* pBuffer = simGetVisionSensorImage(m_objectHandle);
-  if (pBuffer == NULL) {
-    std::cout << " -- ERROR, CameraRTC::No image received, but no error" << std::endl;
+  uint32_t tick = m_tick++;
+  int topLevel;
+  int nextTopLevel;
+  if (m_renderOnDemand && publishes(m_tick, &nextTopLevel)) {
+    // Rendered on the V-REP main thread before the next tick.
+    visionSensors.request(m_objectHandle);
+  }
+  if (!publishes(tick, &topLevel)) {
     return RTC::RTC_OK;
   }
-
-  
+  bool publishBase = (tick % m_tickPeriod == 0);
+  m_allocationCheck.begin();
   float time = simGetSimulationTime();
+  if (m_renderOnDemand && !visionSensors.rendered(m_objectHandle)) {
+    if (m_imageError.raise(time)) {
+      std::cout << " -- ERROR, CameraRTC::Rendering failed (" << m_imageError.take() << " times)" << std::endl;
+    }
+    return RTC::RTC_OK;
+  }
+
+  EncodeJob* job = NULL;
+  uint8_t* dst = NULL;
+  if (publishBase && m_encodeWorker.isRunning()) {
+    job = m_encodeWorker.acquire();
+    if (job != NULL) { // NULL if the only frame slot is being encoded, skip this frame.
+      job->image.resize(pixelFormatSize(m_pixelFormat, m_width, m_height));
+      dst = &job->image[0];
+    }
+  } else if (publishBase) {
+    dst = m_image.pixels.get_buffer();
+  }
+  if (dst == NULL && topLevel == 0) {
+    return RTC::RTC_OK;
+  }
+  if (!convertImage(dst, time)) {
+    if (job != NULL) {
+      m_encodeWorker.release(job);
+    }
+    return RTC::RTC_OK;
+  }
+
   long sec = floor(time);
   long nsec = (time - sec) * 1000*1000*1000;
-  m_image.tm.sec = sec;
-  m_image.tm.nsec = nsec;
-
-  for (int i = 0;i < m_image.height;i++) {
-    for (int j = 0;j < m_image.width;j++) {
-      int index = i*m_image.width*3 + j*3; 
-      int buffer_index = (m_image.width * (m_image.height-i-1)) * 3 + j*3;
-      m_image.pixels[buffer_index + 0] = static_cast<unsigned char>(pBuffer[index+2] * 255);
-      m_image.pixels[buffer_index + 1] = static_cast<unsigned char>(pBuffer[index+1] * 255);
-      m_image.pixels[buffer_index + 2] = static_cast<unsigned char>(pBuffer[index+0] * 255);
+  if (topLevel > 0) {
+    m_pyramid.build(&m_bgr[0], topLevel);
+    for(int k = 1;k <= topLevel;k++) {
+      if (tick % m_pyramidRates[k - 1] == 0) {
+	RTC::CameraImage& image = *m_levelImage[k - 1];
+	convertBGRImage(m_pyramid.level(k), image.width, image.height, m_pixelFormat, image.pixels.get_buffer());
+	image.tm.sec = sec;
+	image.tm.nsec = nsec;
+      }
     }
   }
-  simReleaseBuffer((simChar*)pBuffer);
-  m_imageOut.write();
+  if (job != NULL) {
+    job->width = m_width;
+    job->height = m_height;
+    job->channels = m_pixelFormat == PIXEL_MONO8 ? 1 : 3;
+    job->time = time;
+    m_encodeWorker.submit(job);
+  }
+  m_allocationCheck.end(time);
+
+  for(int k = 1;k <= topLevel;k++) {
+    if (tick % m_pyramidRates[k - 1] == 0) {
+      m_levelOut[k - 1]->write();
+    }
+  }
+  if (job == NULL && dst != NULL) {
+    m_image.tm.sec = sec;
+    m_image.tm.nsec = nsec;
+    m_imageOut.write();
+  }
 
   
   
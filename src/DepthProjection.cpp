@@ -0,0 +1,214 @@
+#include "DepthProjection.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEPTH_PROJECTION_SSE
+#include <emmintrin.h>
+#endif
+
+void DepthProjection::allocate(const int width, const int height, const float nearClipping, const float farClipping)
+{
+  m_width = width;
+  m_height = height;
+  m_near = nearClipping;
+  m_far = farClipping;
+  m_rayX.resize(width * height);
+  m_rayY.resize(width * height);
+  m_rayZ.resize(width * height);
+  m_focalLength = 0;
+  m_transformed = false;
+}
+
+void DepthProjection::configurePinhole(const int width, const int height, const float perspectiveAngle,
+				       const float nearClipping, const float farClipping)
+{
+  allocate(width, height, nearClipping, farClipping);
+  const int size = width > height ? width : height;
+  const float f = (size / 2.0f) / tanf(perspectiveAngle / 2.0f);
+  m_focalLength = f;
+  for(int i = 0;i < height;i++) {
+    for(int j = 0;j < width;j++) {
+      int index = i * width + j;
+      m_rayX[index] = 1.0f;
+      m_rayY[index] = -(j + 0.5f - width / 2.0f) / f;
+      m_rayZ[index] = (i + 0.5f - height / 2.0f) / f;
+    }
+  }
+}
+
+void DepthProjection::configureSpherical(const int width, const int height, const double angularResolution,
+					 const float nearClipping, const float farClipping)
+{
+  allocate(width, height, nearClipping, farClipping);
+  for(int i = 0;i < height;i++) {
+    double vertical = (i - height / 2) * angularResolution;
+    for(int j = 0;j < width;j++) {
+      double horizontal = (j - width / 2) * angularResolution;
+      int index = i * width + j;
+      m_rayX[index] = (float)(cos(vertical) * cos(horizontal));
+      m_rayY[index] = (float)(-cos(vertical) * sin(horizontal));
+      m_rayZ[index] = (float)sin(vertical);
+    }
+  }
+}
+
+void DepthProjection::setSensorPose(const float* matrix)
+{
+  // Point frame (x forward, y left, z up) is the sensor z, x and y axis.
+  for(int r = 0;r < 3;r++) {
+    m_transform[r * 4 + 0] = matrix[r * 4 + 2];
+    m_transform[r * 4 + 1] = matrix[r * 4 + 0];
+    m_transform[r * 4 + 2] = matrix[r * 4 + 1];
+    m_transform[r * 4 + 3] = matrix[r * 4 + 3];
+  }
+  m_transformed = true;
+}
+
+void DepthProjection::projectScalar(const float* depth, float* points, const int begin, const int end) const
+{
+  const float scale = m_far - m_near;
+  const float* m = m_transform;
+  for(int i = begin;i < end;i++) {
+    float d = m_near + depth[i] * scale;
+    float x = m_rayX[i] * d;
+    float y = m_rayY[i] * d;
+    float z = m_rayZ[i] * d;
+    if (m_transformed) {
+      float wx = m[0] * x + m[1] * y + m[2] * z + m[3];
+      float wy = m[4] * x + m[5] * y + m[6] * z + m[7];
+      float wz = m[8] * x + m[9] * y + m[10] * z + m[11];
+      x = wx;
+      y = wy;
+      z = wz;
+    }
+    points[i * 4 + 0] = x;
+    points[i * 4 + 1] = y;
+    points[i * 4 + 2] = z;
+    points[i * 4 + 3] = 0.0f;
+  }
+}
+
+void DepthProjection::project(const float* depth, float* points, const int begin, const int end) const
+{
+#ifdef DEPTH_PROJECTION_SSE
+  const __m128 nearClipping = _mm_set1_ps(m_near);
+  const __m128 scale = _mm_set1_ps(m_far - m_near);
+  const float* rx = m_rayX.empty() ? NULL : &m_rayX[0];
+  const float* ry = m_rayY.empty() ? NULL : &m_rayY[0];
+  const float* rz = m_rayZ.empty() ? NULL : &m_rayZ[0];
+  __m128 m[12];
+  for(int k = 0;m_transformed && k < 12;k++) {
+    m[k] = _mm_set1_ps(m_transform[k]);
+  }
+  int i = begin;
+  for(;i + 4 <= end;i += 4) {
+    __m128 d = _mm_add_ps(nearClipping, _mm_mul_ps(_mm_loadu_ps(depth + i), scale));
+    __m128 x = _mm_mul_ps(_mm_loadu_ps(rx + i), d);
+    __m128 y = _mm_mul_ps(_mm_loadu_ps(ry + i), d);
+    __m128 z = _mm_mul_ps(_mm_loadu_ps(rz + i), d);
+    if (m_transformed) {
+      __m128 wx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)), _mm_add_ps(_mm_mul_ps(m[2], z), m[3]));
+      __m128 wy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], x), _mm_mul_ps(m[5], y)), _mm_add_ps(_mm_mul_ps(m[6], z), m[7]));
+      __m128 wz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], x), _mm_mul_ps(m[9], y)), _mm_add_ps(_mm_mul_ps(m[10], z), m[11]));
+      x = wx;
+      y = wy;
+      z = wz;
+    }
+    __m128 w = _mm_setzero_ps();
+    // x0x1x2x3, y0.., z0.. to x0y0z0w0, x1y1z1w1, ...
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storeu_ps(points + i * 4, x);
+    _mm_storeu_ps(points + i * 4 + 4, y);
+    _mm_storeu_ps(points + i * 4 + 8, z);
+    _mm_storeu_ps(points + i * 4 + 12, w);
+  }
+  projectScalar(depth, points, i, end);
+#else
+  projectScalar(depth, points, begin, end);
+#endif
+}
+
+static inline uint32_t toByte(const float v) {
+  float x = v * 255.0f;
+  return static_cast<uint32_t>(x > 0.0f ? (x < 255.0f ? x : 255.0f) : 0.0f);
+}
+
+void DepthProjection::colour(const float* image, float* points, const int begin, const int end) const
+{
+  for(int i = begin;i < end;i++) {
+    const float* p = image + i * 3;
+    uint32_t rgb = (toByte(p[0]) << 16) | (toByte(p[1]) << 8) | toByte(p[2]);
+    memcpy(points + i * 4 + 3, &rgb, 4);
+  }
+}
+
+static inline uint16_t toMillimetres(const float depth, const float scale, const float offset) {
+  // offset includes the 0.5 of the rounding.
+  const float mm = depth * scale + offset;
+  return (depth >= 1.0f || mm < 0.0f || mm >= 65536.0f) ? 0 : (uint16_t)mm;
+}
+
+void DepthProjection::depthImage16(const float* depth, uint16_t* dst) const
+{
+  const float scale = (m_far - m_near) * 1000.0f;
+  const float offset = m_near * 1000.0f + 0.5f;
+  for(int r = 0;r < m_height;r++) {
+    // V-REP rows are counted from the bottom.
+    const float* src = depth + (m_height - 1 - r) * m_width;
+    uint16_t* row = dst + r * m_width;
+    int i = 0;
+#ifdef DEPTH_PROJECTION_SSE
+    const __m128 s = _mm_set1_ps(scale);
+    const __m128 o = _mm_set1_ps(offset);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 limit = _mm_set1_ps(65536.0f);
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i sign = _mm_set1_epi16((short)0x8000);
+    for(;i + 8 <= m_width;i += 8) {
+      __m128 v0 = _mm_loadu_ps(src + i);
+      __m128 v1 = _mm_loadu_ps(src + i + 4);
+      __m128 mm0 = _mm_add_ps(_mm_mul_ps(v0, s), o);
+      __m128 mm1 = _mm_add_ps(_mm_mul_ps(v1, s), o);
+      // Rounded millimetres - 32768, so the signed saturating pack clamps negative depths to 0.
+      __m128i d0 = _mm_sub_epi32(_mm_cvttps_epi32(mm0), bias);
+      __m128i d1 = _mm_sub_epi32(_mm_cvttps_epi32(mm1), bias);
+      __m128i packed = _mm_xor_si128(_mm_packs_epi32(d0, d1), sign);
+      // No hit or out of range.
+      __m128 invalid0 = _mm_or_ps(_mm_cmpge_ps(v0, one), _mm_cmpge_ps(mm0, limit));
+      __m128 invalid1 = _mm_or_ps(_mm_cmpge_ps(v1, one), _mm_cmpge_ps(mm1, limit));
+      __m128i invalid = _mm_packs_epi32(_mm_castps_si128(invalid0), _mm_castps_si128(invalid1));
+      packed = _mm_andnot_si128(invalid, packed);
+      _mm_storeu_si128((__m128i*)(row + i), packed);
+    }
+#endif
+    for(;i < m_width;i++) {
+      row[i] = toMillimetres(src[i], scale, offset);
+    }
+  }
+}
+
+void DepthProjection::depthImage16Scalar(const float* depth, uint16_t* dst) const
+{
+  const float scale = (m_far - m_near) * 1000.0f;
+  const float offset = m_near * 1000.0f + 0.5f;
+  for(int r = 0;r < m_height;r++) {
+    const float* src = depth + (m_height - 1 - r) * m_width;
+    uint16_t* row = dst + r * m_width;
+    for(int i = 0;i < m_width;i++) {
+      row[i] = toMillimetres(src[i], scale, offset);
+    }
+  }
+}
+
+void DepthProjection::depthImage32(const float* depth, float* dst) const
+{
+  const float scale = m_far - m_near;
+  for(int r = 0;r < m_height;r++) {
+    const float* src = depth + (m_height - 1 - r) * m_width;
+    float* row = dst + r * m_width;
+    for(int i = 0;i < m_width;i++) {
+      row[i] = src[i] >= 1.0f ? 0.0f : m_near + src[i] * scale;
+    }
+  }
+}
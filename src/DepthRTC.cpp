@@ -8,10 +8,13 @@
  */
 
 #include "DepthRTC.h"
+#include "VisionSensorManager.h"
+#include "PackedPointCloud.h"
 #include <string>
 #include <sstream>
 #include <iostream>
 #include <math.h>
+#include <string.h>
 #include <v_repLib.h>
 // Module specification
 // <rtc-template block="module_spec">
@@ -32,14 +35,37 @@ static const char* depthrtc_spec[] =
     "conf.default.objectName", "none",
     //"conf.default.offset", "0,0,0,0,0,0",
     //    "conf.default.objectHandle", "-1",
-    "conf.default.angularResolution", "0.9948", 
+    "conf.default.angularResolution", "0",
+    "conf.default.renderMode", "always",
+    "conf.default.outputFormat", "pointCloud",
+    "conf.default.pointStride", "1",
+    "conf.default.voxelSize", "0.0",
+    "conf.default.cullFarPlane", "off",
+    "conf.default.octreeResolution", "0.01",
+    "conf.default.frame", "sensor",
+    "conf.default.workerThreads", "0",
     //"conf.default.activeJointNames", "[]",
     // Widget
     "conf.__widget__.objectName", "text",
     //"conf.__widget__.objectHandle", "text",
     "conf.__widget__.activeJointNames", "text",
+    "conf.__widget__.renderMode", "radio",
+    "conf.__widget__.outputFormat", "radio",
+    "conf.__widget__.pointStride", "text",
+    "conf.__widget__.voxelSize", "text",
+    "conf.__widget__.cullFarPlane", "radio",
+    "conf.__widget__.octreeResolution", "text",
+    "conf.__widget__.frame", "radio",
+    "conf.__widget__.workerThreads", "text",
 
     // Constraints
+    "conf.__constraints__.renderMode", "(always,onDemand)",
+    "conf.__constraints__.outputFormat", "(pointCloud,packed,depth16,depth32f,octree)",
+    "conf.__constraints__.pointStride", "1<=x",
+    "conf.__constraints__.cullFarPlane", "(on,off)",
+    "conf.__constraints__.octreeResolution", "0<x",
+    "conf.__constraints__.frame", "(sensor,world)",
+    "conf.__constraints__.workerThreads", "0<=x",
     ""
   };
 // </rtc-template>
@@ -51,8 +77,24 @@ static const char* depthrtc_spec[] =
 DepthRTC::DepthRTC(RTC::Manager* manager)
     // <rtc-template block="initializer">
   : RTC::DataFlowComponentBase(manager),
-    m_pointCloudOut("pointCloud", m_pointCloud)
+    m_pointCloudOut("pointCloud", m_pointCloud),
+    m_packedPointCloudOut("packedPointCloud", m_packedPointCloud),
+    m_depthImageOut("depthImage", m_depthImage),
+    m_intrinsicsOut("intrinsics", m_intrinsics),
+    m_octreePointCloudOut("octreePointCloud", m_octreePointCloud),
+    m_compressionStatsOut("compressionStats", m_compressionStats),
+    m_sensorPoseOut("sensorPose", m_sensorPose),
     // </rtc-template>
+    m_renderOnDemand(false),
+    m_allocationCheck("DepthRTC"),
+    m_outputMode(OUTPUT_POINT_CLOUD),
+    m_filtered(false),
+    m_stride(1),
+    m_cull(false),
+    m_worldFrame(false),
+    m_filterWorker(m_pointCloudOut, m_packedPointCloudOut),
+    m_encodeWorker(m_octreePointCloudOut, m_compressionStatsOut),
+    m_cloudWorker(&m_filterWorker)
 {
 }
 
@@ -65,6 +107,33 @@ DepthRTC::~DepthRTC()
 
 
 
+void DepthCloudTask::execute(const int block)
+{
+  const int width = projection->width();
+  const int first = block * rowsPerBlock;
+  int last = first + rowsPerBlock;
+  if (last > projection->height()) {
+    last = projection->height();
+  }
+  projection->project(depth, points, first * width, last * width);
+  projection->colour(image, points, first * width, last * width);
+  if (cloud == NULL) {
+    return;
+  }
+  for (int index = first * width;index < last * width;index++) {
+    const float* p = &points[index * 4];
+    uint32_t rgb;
+    memcpy(&rgb, p + 3, 4);
+    cloud->points[index].point.x = p[0];
+    cloud->points[index].point.y = p[1];
+    cloud->points[index].point.z = p[2];
+    cloud->points[index].colour.r = (rgb >> 16) & 0xFF;
+    cloud->points[index].colour.g = (rgb >> 8) & 0xFF;
+    cloud->points[index].colour.b = rgb & 0xFF;
+  }
+}
+
+
 RTC::ReturnCode_t DepthRTC::onInitialize()
 {
   // Registration: InPort/OutPort/Service
@@ -73,6 +142,12 @@ RTC::ReturnCode_t DepthRTC::onInitialize()
 
   // Set OutPort buffer
   addOutPort("pointCloud", m_pointCloudOut);
+  addOutPort("packedPointCloud", m_packedPointCloudOut);
+  addOutPort("depthImage", m_depthImageOut);
+  addOutPort("intrinsics", m_intrinsicsOut);
+  addOutPort("octreePointCloud", m_octreePointCloudOut);
+  addOutPort("compressionStats", m_compressionStatsOut);
+  addOutPort("sensorPose", m_sensorPoseOut);
 
   // Set service provider to Ports
   
@@ -87,7 +162,15 @@ RTC::ReturnCode_t DepthRTC::onInitialize()
   bindParameter("objectName", m_objectName, "none");
   //bindParameter("geometry_offset", m_offsetStr, "0,0,0,0,0,0");
   // </rtc-template>
-  bindParameter("angularResolution", m_angularResolution, "0.9948");
+  bindParameter("angularResolution", m_angularResolution, "0");
+  bindParameter("renderMode", m_renderMode, "always");
+  bindParameter("outputFormat", m_outputFormat, "pointCloud");
+  bindParameter("pointStride", m_pointStride, "1");
+  bindParameter("voxelSize", m_voxelSize, "0.0");
+  bindParameter("cullFarPlane", m_cullFarPlane, "off");
+  bindParameter("octreeResolution", m_octreeResolution, "0.01");
+  bindParameter("frame", m_frame, "sensor");
+  bindParameter("workerThreads", m_workerThreads, "0");
   std::cout << " - Initializing Depth: " << m_properties.getProperty("conf.default.objectName") <<  std::endl;
 
   std::string objhandle = m_properties.getProperty("conf.__innerparam.objectHandle");
@@ -131,72 +214,294 @@ RTC::ReturnCode_t DepthRTC::onActivated(RTC::UniqueId ec_id)
   std::cout << " -- Depth Resolution Height= " << resolution[1] << std::endl;
   m_width = resolution[0];
   m_height = resolution[1];
-  m_pointCloud.points.length(resolution[0] * resolution[1]);
+
+  // The rays never change while the sensor is active, only the depth does.
+  float nearClipping, farClipping;
+  if (simGetObjectFloatParameter(m_objectHandle, sim_visionfloatparam_near_clipping, &nearClipping) <= 0 ||
+      simGetObjectFloatParameter(m_objectHandle, sim_visionfloatparam_far_clipping, &farClipping) <= 0) {
+    std::cout << " -- Clipping Plane Request Failed." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  if (m_angularResolution > 0) {
+    m_projection.configureSpherical(m_width, m_height, m_angularResolution, nearClipping, farClipping);
+    std::cout << " -- Projection = spherical (" << m_angularResolution << " rad/pixel)" << std::endl;
+  } else {
+    simInt perspective;
+    float angle;
+    if (simGetObjectIntParameter(m_objectHandle, sim_visionintparam_perspective_operation, &perspective) <= 0 ||
+	simGetObjectFloatParameter(m_objectHandle, sim_visionfloatparam_perspective_angle, &angle) <= 0) {
+      std::cout << " -- Perspective Angle Request Failed." << std::endl;
+      return RTC::RTC_ERROR;
+    }
+    if (perspective == 0) {
+      std::cout << " -- Orthographic vision sensors need angularResolution." << std::endl;
+      return RTC::RTC_ERROR;
+    }
+    m_projection.configurePinhole(m_width, m_height, angle, nearClipping, farClipping);
+    std::cout << " -- Projection = pinhole (" << angle << " rad)" << std::endl;
+  }
+  std::cout << " -- Clipping Planes = " << nearClipping << " - " << farClipping << std::endl;
+  std::cout << " -- Output Format = " << m_outputFormat << std::endl;
+  // The pose is applied or not for the whole activation, as the flags say.
+  m_worldFrame = (m_frame == "world");
+  // onExecute follows this copy, the buffers are sized for it only.
+  if (m_outputFormat == "packed") {
+    m_outputMode = OUTPUT_PACKED;
+  } else if (m_outputFormat == "depth16") {
+    m_outputMode = OUTPUT_DEPTH16;
+  } else if (m_outputFormat == "depth32f") {
+    m_outputMode = OUTPUT_DEPTH32F;
+  } else if (m_outputFormat == "octree") {
+    m_outputMode = OUTPUT_OCTREE;
+  } else {
+    m_outputMode = OUTPUT_POINT_CLOUD;
+  }
+  if ((m_outputMode == OUTPUT_DEPTH16 || m_outputMode == OUTPUT_DEPTH32F) && m_projection.focalLength() <= 0) {
+    std::cout << " -- Depth images need a pinhole projection (angularResolution = 0)." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  m_filtered = false;
+  m_depthImage.pixels.length(0);
+  m_intrinsics.data.length(0);
+  if (m_outputMode == OUTPUT_DEPTH16 || m_outputMode == OUTPUT_DEPTH32F) {
+    // No back-projection, only the linearized depth.
+    m_points.clear();
+    m_pointCloud.points.length(0);
+    m_packedPointCloud.data.length(0);
+    m_depthImage.width = m_width;
+    m_depthImage.height = m_height;
+    m_depthImage.bpp = m_outputMode == OUTPUT_DEPTH16 ? 16 : 32;
+    m_depthImage.format = m_outputMode == OUTPUT_DEPTH16 ? "depth16" : "depth32f";
+    m_depthImage.fDiv = 1.0;
+    m_depthImage.pixels.length(m_width * m_height * m_depthImage.bpp / 8);
+    m_intrinsics.data.length(6);
+    m_intrinsics.data[0] = m_projection.focalLength();
+    m_intrinsics.data[1] = m_projection.focalLength();
+    m_intrinsics.data[2] = m_width / 2.0 - 0.5;
+    m_intrinsics.data[3] = m_height / 2.0 - 0.5;
+    m_intrinsics.data[4] = nearClipping;
+    m_intrinsics.data[5] = farClipping;
+  } else if (m_outputMode == OUTPUT_OCTREE || m_pointStride > 1 || m_voxelSize > 0 || m_cullFarPlane == "on") {
+    // The filter (or encode) worker publishes, the full projection is only scratch.
+    m_filtered = true;
+    m_pointCloud.points.length(0);
+    m_packedPointCloud.data.length(0);
+    m_points.resize(m_width * m_height * 4);
+    // The job buffers are sized for this stride, onExecute keeps to it.
+    m_stride = m_pointStride > 1 ? m_pointStride : 1;
+    m_cull = (m_cullFarPlane == "on");
+    m_filteredPoints = ((m_width + m_stride - 1) / m_stride) * ((m_height + m_stride - 1) / m_stride);
+    if (m_outputMode == OUTPUT_OCTREE) {
+      m_encodeWorker.configure(m_filteredPoints, (float)m_octreeResolution);
+      m_cloudWorker = &m_encodeWorker;
+      std::cout << " -- Octree Resolution = " << m_octreeResolution << std::endl;
+    } else {
+      m_filterWorker.configure(m_outputMode == OUTPUT_PACKED, m_filteredPoints, (float)m_voxelSize, nearClipping, farClipping);
+      m_cloudWorker = &m_filterWorker;
+    }
+    m_cloudWorker->start(2);
+    std::cout << " -- Point Stride = " << m_stride << ", Voxel Size = " << m_voxelSize
+	      << ", Cull Far Plane = " << m_cullFarPlane << std::endl;
+  } else if (m_outputMode == OUTPUT_PACKED) {
+    // The points are projected straight into the octet sequence.
+    m_points.clear();
+    m_pointCloud.points.length(0);
+    m_packedPointCloud.data.length(sizeof(PackedPointCloudHeader) + m_width * m_height * PACKED_POINT_SIZE);
+    PackedPointCloudHeader header;
+    memcpy(header.magic, "PPC1", 4);
+    header.width = m_width;
+    header.height = m_height;
+    header.pointSize = PACKED_POINT_SIZE;
+    header.flags = m_worldFrame ? PACKED_POINT_WORLD_FRAME : PACKED_POINT_SENSOR_FRAME;
+    header.nearClipping = nearClipping;
+    header.farClipping = farClipping;
+    header.reserved = 0;
+    memset(header.pose, 0, sizeof(header.pose));
+    memcpy(m_packedPointCloud.data.get_buffer(), &header, sizeof(header));
+  } else {
+    m_points.resize(m_width * m_height * 4);
+    m_pointCloud.points.length(resolution[0] * resolution[1]);
+    m_packedPointCloud.data.length(0);
+  }
+  // A few blocks per thread even out rows which take longer.
+  m_blocks = (m_workerThreads > 0) ? (m_workerThreads + 1) * 4 : 1;
+  if (m_blocks > m_height) {
+    m_blocks = m_height;
+  }
+  m_cloudTask.projection = &m_projection;
+  m_cloudTask.rowsPerBlock = (m_height + m_blocks - 1) / m_blocks;
+  m_workerPool.start(m_workerThreads);
+  m_published = 0;
+  m_projection.clearSensorPose();
+  std::cout << " -- Frame = " << m_frame << std::endl;
+  std::cout << " -- Worker Threads = " << m_workerThreads << " (" << m_blocks << " row blocks)" << std::endl;
+  m_renderOnDemand = visionSensors.acquire(m_objectHandle, m_renderMode == "onDemand");
+  if (m_renderMode == "onDemand" && !m_renderOnDemand) {
+    std::cout << " -- Explicit handling of the vision sensor failed, rendered on every step." << std::endl;
+  }
+  if (m_renderOnDemand) {
+    visionSensors.request(m_objectHandle);
+  }
   return RTC::RTC_OK;
 }
 
 
 RTC::ReturnCode_t DepthRTC::onDeactivated(RTC::UniqueId ec_id)
 {
+  m_workerPool.stop();
+  if (m_filterWorker.isRunning()) {
+    m_filterWorker.stop();
+    std::cout << " - Deactivated DepthRTC: " << m_filterWorker.processed() << " clouds filtered ("
+	      << m_filterWorker.inputPoints() << " -> " << m_filterWorker.outputPoints() << " points), "
+	      << m_filterWorker.dropped() << " dropped." << std::endl;
+  }
+  if (m_encodeWorker.isRunning()) {
+    m_encodeWorker.stop();
+    const uint32_t encoded = m_encodeWorker.processed();
+    std::cout << " - Deactivated DepthRTC: " << encoded << " clouds encoded (ratio "
+	      << m_encodeWorker.compressionRatio() << ", "
+	      << (encoded > 0 ? m_encodeWorker.encodeTime() * 1000 / encoded : 0) << " ms per cloud), "
+	      << m_encodeWorker.dropped() << " dropped." << std::endl;
+  }
+  if (m_imageError.total() > 0) {
+    std::cout << " - Deactivated DepthRTC: " << m_imageError.total() << " ticks without image." << std::endl;
+  }
+  if (m_renderOnDemand) {
+    std::cout << " - Deactivated DepthRTC: " << visionSensors.renderCount(m_objectHandle) << " renderings ("
+	      << visionSensors.renderRate(m_objectHandle) << " per sec) for " << m_published << " published frames." << std::endl;
+  }
+  visionSensors.release(m_objectHandle, m_renderOnDemand);
+  m_renderOnDemand = false;
+  m_imageError.reset();
+  m_allocationCheck.reset();
   return RTC::RTC_OK;
 }
 
 RTC::ReturnCode_t DepthRTC::onExecute(RTC::UniqueId ec_id)
 {
-  float* auxValues=NULL;
-  int* auxValuesCount=NULL;
-  float minDepth, maxDepth;
-  if (simCheckVisionSensor(m_objectHandle, sim_handle_all, &auxValues,&auxValuesCount)>=0) {
-    if ((auxValuesCount[0]>0)||(auxValuesCount[1]>=15)) {
-      minDepth = auxValues[4];
-      maxDepth = auxValues[9];
+  m_allocationCheck.begin();
+  float time = simGetSimulationTime();
+  if (m_renderOnDemand) {
+    // Every tick publishes, rendered on the V-REP main thread before the next one.
+    visionSensors.request(m_objectHandle);
+  }
+  if (m_renderOnDemand && !visionSensors.rendered(m_objectHandle)) {
+    if (m_imageError.raise(time)) {
+      std::cout << " -- ERROR, DepthRTC::Rendering failed (" << m_imageError.take() << " times)" << std::endl;
     }
-    simReleaseBuffer((char*)auxValues);
-    simReleaseBuffer((char*)auxValuesCount);
+    return RTC::RTC_OK;
   }
 
-  simFloat* pBuffer = simGetVisionSensorDepthBuffer(m_objectHandle);
+  // Shared with a CameraRTC on the same sensor, fetched once per step.
+  const float* pBuffer = visionSensors.depthBuffer(m_objectHandle, time);
   if (pBuffer == NULL) {
-    std::cout << " -- ERROR, DepthRTC::No image received, but no error" << std::endl;
+    if (m_imageError.raise(time)) {
+      std::cout << " -- ERROR, DepthRTC::No image received, but no error (" << m_imageError.take() << " times)" << std::endl;
+    }
     return RTC::RTC_OK;
   }
 
-  simFloat* pImgBuffer = simGetVisionSensorImage(m_objectHandle);
-  if (pImgBuffer == NULL) {
-    std::cout << " -- ERROR, DepthRTC::No image received, but no error" << std::endl;
-    simReleaseBuffer((simChar*)pBuffer);
+  long sec = floor(time);
+  long nsec = (time - sec) * 1000*1000*1000;
+  if (m_outputMode == OUTPUT_DEPTH16 || m_outputMode == OUTPUT_DEPTH32F) {
+    if (m_outputMode == OUTPUT_DEPTH16) {
+      m_projection.depthImage16(pBuffer, (uint16_t*)m_depthImage.pixels.get_buffer());
+    } else {
+      m_projection.depthImage32(pBuffer, (float*)m_depthImage.pixels.get_buffer());
+    }
+    m_depthImage.tm.sec = m_intrinsics.tm.sec = sec;
+    m_depthImage.tm.nsec = m_intrinsics.tm.nsec = nsec;
+    m_allocationCheck.end(time);
+    m_published++;
+    m_depthImageOut.write();
+    m_intrinsicsOut.write();
     return RTC::RTC_OK;
   }
 
-  
-  float time = simGetSimulationTime();
-  long sec = floor(time);
-  long nsec = (time - sec) * 1000*1000*1000;
-  m_pointCloud.tm.sec = sec;
-  m_pointCloud.tm.nsec = nsec;
+  const float* pImgBuffer = visionSensors.image(m_objectHandle, time);
+  if (pImgBuffer == NULL) {
+    if (m_imageError.raise(time)) {
+      std::cout << " -- ERROR, DepthRTC::No image received, but no error (" << m_imageError.take() << " times)" << std::endl;
+    }
+    return RTC::RTC_OK;
+  }
 
-  for (int i = 0;i < m_height;i++) {
-    for (int j = 0;j < m_width;j++) {
-      int index = i*m_width + j; 
-      double vertical_angle = (i - m_height/2) * m_angularResolution;
-      double horizontal_angle = (j - m_width/2) * m_angularResolution;
-      float depth = pBuffer[index];
-      double sinV = sin(vertical_angle);
-      double cosV = cos(vertical_angle);
-      double sinH = sin(horizontal_angle);
-      double cosH = cos(horizontal_angle);
-      m_pointCloud.points[index].point.x = depth * cosV * cosH;
-      m_pointCloud.points[index].point.y = depth * cosV * sinH;
-      m_pointCloud.points[index].point.z = depth * sinV;
-
-      int img_index = i*m_width*3 + j*3; 
-      m_pointCloud.points[index].colour.r = static_cast<unsigned char>(pBuffer[img_index+2] * 255);
-      m_pointCloud.points[index].colour.g = static_cast<unsigned char>(pBuffer[img_index+1] * 255);
-      m_pointCloud.points[index].colour.b = static_cast<unsigned char>(pBuffer[img_index+0] * 255);
+  // The pose of this step goes with the cloud, in world frame it is applied during the projection.
+  float matrix[12];
+  simFloat orientation[3];
+  if (simGetObjectMatrix(m_objectHandle, -1, matrix) < 0 ||
+      simGetObjectOrientation(m_objectHandle, -1, orientation) < 0) {
+    if (m_imageError.raise(time)) {
+      std::cout << " -- ERROR, DepthRTC::Sensor pose request failed (" << m_imageError.take() << " times)" << std::endl;
     }
+    return RTC::RTC_OK;
   }
-  simReleaseBuffer((simChar*)pBuffer);
-  simReleaseBuffer((simChar*)pImgBuffer);
+  if (m_worldFrame) {
+    m_projection.setSensorPose(matrix);
+  }
+  m_sensorPose.tm.sec = sec;
+  m_sensorPose.tm.nsec = nsec;
+  m_sensorPose.data.position.x = matrix[3];
+  m_sensorPose.data.position.y = matrix[7];
+  m_sensorPose.data.position.z = matrix[11];
+  m_sensorPose.data.orientation.r = orientation[0];
+  m_sensorPose.data.orientation.p = orientation[1];
+  m_sensorPose.data.orientation.y = orientation[2];
+
+  if (m_filtered) {
+    PointCloudJob* job = m_cloudWorker->acquire();
+    if (job == NULL) { // The only slot is being filtered, skip this frame.
+      return RTC::RTC_OK;
+    }
+    job->points.resize(m_filteredPoints * 4);
+    int count = 0;
+    for (int i = 0;i < m_height;i += m_stride) {
+      int begin = i * m_width;
+      m_projection.project(pBuffer, &m_points[0], begin, begin + m_width);
+      m_projection.colour(pImgBuffer, &m_points[0], begin, begin + m_width);
+      for (int index = begin;index < begin + m_width;index += m_stride) {
+	if (m_cull && pBuffer[index] >= 1.0f) {
+	  continue;
+	}
+	memcpy(&job->points[count * 4], &m_points[index * 4], 4 * sizeof(float));
+	count++;
+      }
+    }
+    job->count = count;
+    job->time = time;
+    job->flags = m_worldFrame ? PACKED_POINT_WORLD_FRAME : PACKED_POINT_SENSOR_FRAME;
+    memcpy(job->pose, matrix, sizeof(matrix));
+    m_cloudWorker->submit(job);
+    m_allocationCheck.end(time);
+    m_published++;
+    m_sensorPoseOut.write();
+    return RTC::RTC_OK;
+  }
+  m_cloudTask.depth = pBuffer;
+  m_cloudTask.image = pImgBuffer;
+  if (m_outputMode == OUTPUT_PACKED) {
+    m_cloudTask.points = (float*)(m_packedPointCloud.data.get_buffer() + sizeof(PackedPointCloudHeader));
+    m_cloudTask.cloud = NULL;
+    m_workerPool.run(m_cloudTask, m_blocks);
+    PackedPointCloudHeader* header = (PackedPointCloudHeader*)m_packedPointCloud.data.get_buffer();
+    memcpy(header->pose, matrix, sizeof(matrix));
+    m_packedPointCloud.tm.sec = sec;
+    m_packedPointCloud.tm.nsec = nsec;
+    m_allocationCheck.end(time);
+    m_published++;
+    m_sensorPoseOut.write();
+    m_packedPointCloudOut.write();
+    return RTC::RTC_OK;
+  }
+
+  m_pointCloud.tm.sec = sec;
+  m_pointCloud.tm.nsec = nsec;
+  m_cloudTask.points = &m_points[0];
+  m_cloudTask.cloud = &m_pointCloud;
+  m_workerPool.run(m_cloudTask, m_blocks);
+  m_allocationCheck.end(time);
+  m_published++;
+  m_sensorPoseOut.write();
   m_pointCloudOut.write();
 
   
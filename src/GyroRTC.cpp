@@ -35,11 +35,18 @@ static const char* gyrortc_spec[] =
     //"conf.default.minGyro", "0.3",
     //    "conf.default.objectHandle", "-1",
     //"conf.default.activeJointNames", "[]",
+    "conf.default.publishMode", "always",
+    "conf.default.publishDeadband", "0.0",
+    "conf.default.publishKeepAlive", "1.0",
     // Widget
     "conf.__widget__.objectName", "text",
     //"conf.__widget__.objectHandle", "text",
     "conf.__widget__.activeJointNames", "text",
+    "conf.__widget__.publishMode", "radio",
+    "conf.__widget__.publishDeadband", "text",
+    "conf.__widget__.publishKeepAlive", "text",
     // Constraints
+    "conf.__constraints__.publishMode", "(always,onChange)",
     ""
   };
 // </rtc-template>
@@ -51,8 +58,9 @@ static const char* gyrortc_spec[] =
 GyroRTC::GyroRTC(RTC::Manager* manager)
     // <rtc-template block="initializer">
   : RTC::DataFlowComponentBase(manager),
-    m_gyroOut("gyro", m_gyro)
+    m_gyroOut("gyro", m_gyro),
     // </rtc-template>
+    m_allocationCheck("GyroRTC")
 {
 }
 
@@ -85,6 +93,9 @@ RTC::ReturnCode_t GyroRTC::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("objectName", m_objectName, "none");
+  bindParameter("publishMode", m_publishMode, "always");
+  bindParameter("publishDeadband", m_publishDeadband, "0.0");
+  bindParameter("publishKeepAlive", m_publishKeepAlive, "1.0");
   //bindParameter("geometry_offset", m_offsetStr, "0,0,0,0,0,0");
   //bindParameter("maxGyro", m_maxGyro, "30.0");
   //bindParameter("minGyro", m_minGyro, "0.3");
@@ -135,11 +146,17 @@ RTC::ReturnCode_t GyroRTC::onShutdown(RTC::UniqueId ec_id)
 RTC::ReturnCode_t GyroRTC::onActivated(RTC::UniqueId ec_id)
 {
   std::cout << " - Activating GyroRTC: " << m_objectName << std::endl;
+  m_publishFilter.configure(m_publishMode, m_publishDeadband, m_publishKeepAlive);
   return RTC::RTC_OK;
 }
 
 RTC::ReturnCode_t GyroRTC::onDeactivated(RTC::UniqueId ec_id)
 {
+  if (m_sizeError.total() > 0) {
+    std::cout << "[GyroRTC] " << m_sizeError.total() << " messages with invalid data size." << std::endl;
+  }
+  m_sizeError.reset();
+  m_allocationCheck.reset();
   return RTC::RTC_OK;
 }
 
@@ -152,6 +169,7 @@ union float_byte {
 
 RTC::ReturnCode_t GyroRTC::onExecute(RTC::UniqueId ec_id)
 {
+  m_allocationCheck.begin();
   simInt bufSize;
   simChar* pBuffer = simTubeRead(m_tubeHandle, &bufSize);
   if (pBuffer == NULL) {
@@ -160,7 +178,10 @@ RTC::ReturnCode_t GyroRTC::onExecute(RTC::UniqueId ec_id)
   float_byte buffer;
   int data_size = bufSize / 4;
   if (data_size != 3) {
-    std::cout << "[GyroRTC] Invalid data size (" << data_size << "!=3)" << std::endl;
+    if (m_sizeError.raise(simGetSimulationTime())) {
+      std::cout << "[GyroRTC] Invalid data size (" << data_size << "!=3, " << m_sizeError.take() << " times)" << std::endl;
+    }
+    simReleaseBuffer((simChar*)pBuffer);
     return RTC::RTC_OK;
   }
 
@@ -180,7 +201,11 @@ RTC::ReturnCode_t GyroRTC::onExecute(RTC::UniqueId ec_id)
   m_gyro.data.avx = x[0];
   m_gyro.data.avy = x[1];
   m_gyro.data.avz = x[2];
-  m_gyroOut.write();
+  double values[3] = {x[0], x[1], x[2]};
+  m_allocationCheck.end(time);
+  if (m_publishFilter.check(values, 3, time)) {
+    m_gyroOut.write();
+  }
   simReleaseBuffer((simChar*)pBuffer);
   
   return RTC::RTC_OK;
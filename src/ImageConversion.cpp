@@ -0,0 +1,555 @@
+#include "ImageConversion.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_CONVERSION_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(IMAGE_CONVERSION_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+#define IMAGE_CONVERSION_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+typedef void (*RowConverter)(const float* src, uint8_t* dst, int pixels);
+typedef void (*ByteRowConverter)(const uint8_t* src, uint8_t* dst, int pixels);
+typedef void (*FormatRowConverter)(const uint8_t* bgr, uint8_t* dst, int pixels);
+
+static inline uint8_t toByte(const float v) {
+  float x = v * 255.0f;
+  return static_cast<uint8_t>(x > 0.0f ? (x < 255.0f ? x : 255.0f) : 0.0f);
+}
+
+static void convertRowScalar(const float* src, uint8_t* dst, int pixels) {
+  for(int i = 0;i < pixels;i++) {
+    dst[0] = toByte(src[2]);
+    dst[1] = toByte(src[1]);
+    dst[2] = toByte(src[0]);
+    src += 3;
+    dst += 3;
+  }
+}
+
+static void convertByteRowScalar(const uint8_t* src, uint8_t* dst, int pixels) {
+  for(int i = 0;i < pixels;i++) {
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+    src += 3;
+    dst += 3;
+  }
+}
+
+/**
+ * BT.601 luma with weights in 1/128: 15 B + 75 G + 38 R.
+ */
+static void monoRowScalar(const uint8_t* bgr, uint8_t* dst, int pixels) {
+  for(int i = 0;i < pixels;i++) {
+    dst[i] = (uint8_t)((15 * bgr[0] + 75 * bgr[1] + 38 * bgr[2] + 64) >> 7);
+    bgr += 3;
+  }
+}
+
+static void rgb565RowScalar(const uint8_t* bgr, uint8_t* dst, int pixels) {
+  for(int i = 0;i < pixels;i++) {
+    uint16_t v = (uint16_t)(((bgr[2] & 0xF8) << 8) | ((bgr[1] & 0xFC) << 3) | (bgr[0] >> 3));
+    dst[0] = (uint8_t)(v & 0xFF);
+    dst[1] = (uint8_t)(v >> 8);
+    bgr += 3;
+    dst += 2;
+  }
+}
+
+#ifdef IMAGE_CONVERSION_SSE2
+/**
+ * Exchange bytes 0/2, 3/5, 6/8 and 9/11 of a register.
+ */
+static inline __m128i swapRB(const __m128i rgb) {
+  const __m128i middle = _mm_setr_epi8(0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, 0, 0, 0);
+  const __m128i left = _mm_setr_epi8(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, 0, 0, 0, 0);
+  const __m128i right = _mm_setr_epi8(0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, 0, 0);
+  return _mm_or_si128(_mm_and_si128(rgb, middle),
+		      _mm_or_si128(_mm_and_si128(_mm_srli_si128(rgb, 2), left),
+				   _mm_and_si128(_mm_slli_si128(rgb, 2), right)));
+}
+
+/**
+ * Store the lower 12 bytes (4 pixels) of a register.
+ */
+static inline void store12(uint8_t* dst, const __m128i v) {
+  _mm_storel_epi64((__m128i*)dst, v);
+  int tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+  memcpy(dst + 8, &tail, 4);
+}
+
+/**
+ * 4 pixels (12 floats) per iteration. After scaling and packing the 12 bytes
+ * are R G B R G B ..., R and B are exchanged by 2 byte shifts.
+ */
+static void convertRowSSE2(const float* src, uint8_t* dst, int pixels) {
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 zero = _mm_setzero_ps();
+  int i = 0;
+  for(;i + 4 <= pixels;i += 4) {
+    __m128 f0 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + 0), scale), zero), scale);
+    __m128 f1 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + 4), scale), zero), scale);
+    __m128 f2 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + 8), scale), zero), scale);
+    __m128i w01 = _mm_packs_epi32(_mm_cvttps_epi32(f0), _mm_cvttps_epi32(f1));
+    __m128i w2 = _mm_packs_epi32(_mm_cvttps_epi32(f2), _mm_setzero_si128());
+    store12(dst, swapRB(_mm_packus_epi16(w01, w2)));
+    src += 12;
+    dst += 12;
+  }
+  convertRowScalar(src, dst, pixels - i);
+}
+
+/**
+ * 4 pixels per iteration from a 16 byte load, so 2 more pixels of the row
+ * must be readable.
+ */
+static void convertByteRowSSE2(const uint8_t* src, uint8_t* dst, int pixels) {
+  int i = 0;
+  for(;i + 6 <= pixels;i += 4) {
+    store12(dst, swapRB(_mm_loadu_si128((const __m128i*)src)));
+    src += 12;
+    dst += 12;
+  }
+  convertByteRowScalar(src, dst, pixels - i);
+}
+#endif
+
+#ifdef IMAGE_CONVERSION_AVX2
+/**
+ * 8 pixels (24 floats) per iteration. The packed bytes are regrouped so
+ * that each 128 bit lane holds 4 whole pixels and swizzled with pshufb.
+ */
+AVX2_TARGET static void convertRowAVX2(const float* src, uint8_t* dst, int pixels) {
+  const __m256 scale = _mm256_set1_ps(255.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256i regroup = _mm256_setr_epi32(0, 4, 1, 3, 5, 2, 6, 7);
+  const __m256i swizzle = _mm256_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1,
+					   2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+  int i = 0;
+  for(;i + 8 <= pixels;i += 8) {
+    __m256 f0 = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + 0), scale), zero), scale);
+    __m256 f1 = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + 8), scale), zero), scale);
+    __m256 f2 = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + 16), scale), zero), scale);
+    // lane 0: f0[0-3] f1[0-3] f2[0-3] 0, lane 1: f0[4-7] f1[4-7] f2[4-7] 0
+    __m256i w01 = _mm256_packs_epi32(_mm256_cvttps_epi32(f0), _mm256_cvttps_epi32(f1));
+    __m256i w2 = _mm256_packs_epi32(_mm256_cvttps_epi32(f2), _mm256_setzero_si256());
+    __m256i rgb = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(w01, w2), regroup);
+    __m256i bgr = _mm256_shuffle_epi8(rgb, swizzle);
+    store12(dst, _mm256_castsi256_si128(bgr));
+    store12(dst + 12, _mm256_extracti128_si256(bgr, 1));
+    src += 24;
+    dst += 24;
+  }
+  convertRowSSE2(src, dst, pixels - i);
+}
+
+/**
+ * 8 pixels per iteration from a 32 byte load (3 more pixels must be
+ * readable), the second lane is moved to start at byte 12.
+ */
+AVX2_TARGET static void convertByteRowAVX2(const uint8_t* src, uint8_t* dst, int pixels) {
+  const __m256i regroup = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+  const __m256i swizzle = _mm256_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1,
+					   2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+  int i = 0;
+  for(;i + 11 <= pixels;i += 8) {
+    __m256i rgb = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)src), regroup);
+    __m256i bgr = _mm256_shuffle_epi8(rgb, swizzle);
+    store12(dst, _mm256_castsi256_si128(bgr));
+    store12(dst + 12, _mm256_extracti128_si256(bgr, 1));
+    src += 24;
+    dst += 24;
+  }
+  convertByteRowSSE2(src, dst, pixels - i);
+}
+
+/**
+ * Load 8 BGR pixels (3 more pixels must be readable) as 32 bit [B G R 0].
+ */
+AVX2_TARGET static inline __m256i loadPixelsAVX2(const uint8_t* bgr) {
+  const __m256i regroup = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+  const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+					  0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  __m256i v = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)bgr), regroup);
+  return _mm256_shuffle_epi8(v, spread);
+}
+
+AVX2_TARGET static void monoRowAVX2(const uint8_t* bgr, uint8_t* dst, int pixels) {
+  const __m256i weight = _mm256_set1_epi32(15 | (75 << 8) | (38 << 16));
+  const __m256i one = _mm256_set1_epi16(1);
+  const __m256i round = _mm256_set1_epi32(64);
+  int i = 0;
+  for(;i + 11 <= pixels;i += 8) {
+    __m256i p = loadPixelsAVX2(bgr);
+    // (15 B + 75 G, 38 R) per pixel, then summed to 32 bit
+    __m256i y = _mm256_madd_epi16(_mm256_maddubs_epi16(p, weight), one);
+    y = _mm256_srli_epi32(_mm256_add_epi32(y, round), 7);
+    y = _mm256_packus_epi16(_mm256_packs_epi32(y, y), y);
+    int lo = _mm_cvtsi128_si32(_mm256_castsi256_si128(y));
+    int hi = _mm_cvtsi128_si32(_mm256_extracti128_si256(y, 1));
+    memcpy(dst, &lo, 4);
+    memcpy(dst + 4, &hi, 4);
+    bgr += 24;
+    dst += 8;
+  }
+  monoRowScalar(bgr, dst, pixels - i);
+}
+
+AVX2_TARGET static void rgb565RowAVX2(const uint8_t* bgr, uint8_t* dst, int pixels) {
+  const __m256i maskB = _mm256_set1_epi32(0xF8);
+  const __m256i maskG = _mm256_set1_epi32(0xFC00);
+  const __m256i maskR = _mm256_set1_epi32(0xF80000);
+  int i = 0;
+  for(;i + 11 <= pixels;i += 8) {
+    __m256i p = loadPixelsAVX2(bgr);
+    __m256i v = _mm256_or_si256(_mm256_srli_epi32(_mm256_and_si256(p, maskB), 3),
+				_mm256_or_si256(_mm256_srli_epi32(_mm256_and_si256(p, maskG), 5),
+						_mm256_srli_epi32(_mm256_and_si256(p, maskR), 8)));
+    v = _mm256_packus_epi32(v, v);
+    _mm_storel_epi64((__m128i*)dst, _mm256_castsi256_si128(v));
+    _mm_storel_epi64((__m128i*)(dst + 8), _mm256_extracti128_si256(v, 1));
+    bgr += 24;
+    dst += 16;
+  }
+  rgb565RowScalar(bgr, dst, pixels - i);
+}
+
+static bool cpuHasAVX2() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+struct ImageConversionKernel {
+  RowConverter convertRow;
+  ByteRowConverter convertByteRow;
+  FormatRowConverter monoRow;
+  FormatRowConverter rgb565Row;
+  const char* name;
+
+  ImageConversionKernel() {
+    monoRow = monoRowScalar;
+    rgb565Row = rgb565RowScalar;
+#if defined(IMAGE_CONVERSION_AVX2)
+    if (cpuHasAVX2()) {
+      convertRow = convertRowAVX2;
+      convertByteRow = convertByteRowAVX2;
+      monoRow = monoRowAVX2;
+      rgb565Row = rgb565RowAVX2;
+      name = "avx2";
+      return;
+    }
+#endif
+#if defined(IMAGE_CONVERSION_SSE2)
+    convertRow = convertRowSSE2;
+    convertByteRow = convertByteRowSSE2;
+    name = "sse2";
+#else
+    convertRow = convertRowScalar;
+    convertByteRow = convertByteRowScalar;
+    name = "scalar";
+#endif
+  }
+};
+
+static const ImageConversionKernel& kernel() {
+  static ImageConversionKernel k;
+  return k;
+}
+
+int parsePixelFormat(const std::string& name) {
+  if (name == "bgr8") {
+    return PIXEL_BGR8;
+  } else if (name == "mono8") {
+    return PIXEL_MONO8;
+  } else if (name == "nv12") {
+    return PIXEL_NV12;
+  } else if (name == "rgb565") {
+    return PIXEL_RGB565;
+  }
+  return -1;
+}
+
+int pixelFormatBpp(const int format) {
+  switch(format) {
+  case PIXEL_MONO8: return 8;
+  case PIXEL_NV12: return 12;
+  case PIXEL_RGB565: return 16;
+  default: return 24;
+  }
+}
+
+int pixelFormatSize(const int format, const int width, const int height) {
+  switch(format) {
+  case PIXEL_MONO8: return width * height;
+  case PIXEL_NV12: return width * height + (width / 2) * (height / 2) * 2;
+  case PIXEL_RGB565: return width * height * 2;
+  default: return width * height * 3;
+  }
+}
+
+/**
+ * Interleaved UV plane of NV12 from the mean of 2x2 blocks, BT.601 full
+ * range with weights in 1/256.
+ */
+static void convertUVPlane(const uint8_t* bgr, const int width, const int height, uint8_t* uv) {
+  const int stride = width * 3;
+  for(int i = 0;i + 1 < height;i += 2) {
+    const uint8_t* p0 = bgr + i * stride;
+    const uint8_t* p1 = p0 + stride;
+    for(int j = 0;j + 1 < width;j += 2) {
+      int b = (p0[0] + p0[3] + p1[0] + p1[3] + 2) >> 2;
+      int g = (p0[1] + p0[4] + p1[1] + p1[4] + 2) >> 2;
+      int r = (p0[2] + p0[5] + p1[2] + p1[5] + 2) >> 2;
+      int u = (-43 * r - 85 * g + 128 * b + 32896) >> 8;
+      int v = (128 * r - 107 * g - 21 * b + 32896) >> 8;
+      uv[0] = (uint8_t)(u > 255 ? 255 : u);
+      uv[1] = (uint8_t)(v > 255 ? 255 : v);
+      p0 += 6;
+      p1 += 6;
+      uv += 2;
+    }
+  }
+}
+
+static void convertBGR(FormatRowConverter monoRow, FormatRowConverter rgb565Row,
+		       const uint8_t* bgr, const int width, const int height, const int format, uint8_t* dst) {
+  const int stride = width * 3;
+  switch(format) {
+  case PIXEL_MONO8:
+    for(int i = 0;i < height;i++) {
+      monoRow(bgr + i * stride, dst + i * width, width);
+    }
+    break;
+  case PIXEL_NV12:
+    for(int i = 0;i < height;i++) {
+      monoRow(bgr + i * stride, dst + i * width, width);
+    }
+    convertUVPlane(bgr, width, height, dst + width * height);
+    break;
+  case PIXEL_RGB565:
+    for(int i = 0;i < height;i++) {
+      rgb565Row(bgr + i * stride, dst + i * width * 2, width);
+    }
+    break;
+  default:
+    memcpy(dst, bgr, stride * height);
+    break;
+  }
+}
+
+void convertBGRImage(const uint8_t* bgr, const int width, const int height, const int format, uint8_t* dst) {
+  convertBGR(kernel().monoRow, kernel().rgb565Row, bgr, width, height, format, dst);
+}
+
+void convertBGRImageScalar(const uint8_t* bgr, const int width, const int height, const int format, uint8_t* dst) {
+  convertBGR(monoRowScalar, rgb565RowScalar, bgr, width, height, format, dst);
+}
+
+/**
+ * sum[i] += row[i]
+ */
+static void accumulateRow(const uint8_t* row, uint16_t* sum, const int n) {
+  int i = 0;
+#ifdef IMAGE_CONVERSION_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for(;i + 16 <= n;i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+    __m128i lo = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(sum + i)), _mm_unpacklo_epi8(v, zero));
+    __m128i hi = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(sum + i + 8)), _mm_unpackhi_epi8(v, zero));
+    _mm_storeu_si128((__m128i*)(sum + i), lo);
+    _mm_storeu_si128((__m128i*)(sum + i + 8), hi);
+  }
+#endif
+  for(;i < n;i++) {
+    sum[i] += row[i];
+  }
+}
+
+/**
+ * Average binning x binning blocks of the vertical sums of a BGR row.
+ * tmp[i] is the rounded mean of sum[i], sum[i+3], ... (the same channel of
+ * the neighbour pixels), every binning-th pixel of tmp is the result.
+ */
+static void binRow(const uint16_t* sum, const int pixels, const int binning, uint8_t* tmp, uint8_t* dst) {
+  const int n = pixels * 3;
+  const int last = n - 3 * (binning - 1);
+  const int shift = binning == 4 ? 4 : 2;
+  const uint16_t half = (uint16_t)(1 << (shift - 1));
+  int i = 0;
+#ifdef IMAGE_CONVERSION_SSE2
+  const __m128i round = _mm_set1_epi16(half);
+  for(;i + 8 <= last;i += 8) {
+    __m128i h = _mm_loadu_si128((const __m128i*)(sum + i));
+    for(int k = 1;k < binning;k++) {
+      h = _mm_add_epi16(h, _mm_loadu_si128((const __m128i*)(sum + i + 3 * k)));
+    }
+    h = _mm_srli_epi16(_mm_add_epi16(h, round), shift);
+    _mm_storel_epi64((__m128i*)(tmp + i), _mm_packus_epi16(h, h));
+  }
+#endif
+  for(;i < last;i++) {
+    uint16_t h = 0;
+    for(int k = 0;k < binning;k++) {
+      h += sum[i + 3 * k];
+    }
+    tmp[i] = (uint8_t)((h + half) >> shift);
+  }
+  for(int j = 0;j < pixels / binning;j++) {
+    const uint8_t* p = tmp + j * binning * 3;
+    dst[0] = p[0];
+    dst[1] = p[1];
+    dst[2] = p[2];
+    dst += 3;
+  }
+}
+
+
+bool ImagePyramid::configure(const int width, const int height, const int levels)
+{
+  m_levels.clear();
+  m_widths.assign(1, width);
+  m_heights.assign(1, height);
+  for(int k = 1;k <= levels;k++) {
+    int w = m_widths[k - 1] / 2;
+    int h = m_heights[k - 1] / 2;
+    if (w == 0 || h == 0) {
+      return false;
+    }
+    m_widths.push_back(w);
+    m_heights.push_back(h);
+  }
+  m_levels.resize(levels);
+  for(int k = 1;k <= levels;k++) {
+    m_levels[k - 1].resize(m_widths[k] * m_heights[k] * 3);
+  }
+  m_sum.resize(width * 3);
+  m_tmp.resize(width * 3);
+  return true;
+}
+
+void ImagePyramid::build(const uint8_t* base, const int top)
+{
+  for(int k = 1;k <= top && k <= levels();k++) {
+    const uint8_t* src = k == 1 ? base : level(k - 1);
+    const int srcStride = m_widths[k - 1] * 3;
+    // Only the even part of an odd sized level is used.
+    const int n = m_widths[k] * 2 * 3;
+    uint8_t* dst = &m_levels[k - 1][0];
+    for(int r = 0;r < m_heights[k];r++) {
+      memset(&m_sum[0], 0, n * sizeof(uint16_t));
+      accumulateRow(src + (r * 2) * srcStride, &m_sum[0], n);
+      accumulateRow(src + (r * 2 + 1) * srcStride, &m_sum[0], n);
+      binRow(&m_sum[0], m_widths[k] * 2, 2, &m_tmp[0], dst + r * m_widths[k] * 3);
+    }
+  }
+}
+
+
+ImageConverter::ImageConverter() : m_sourceWidth(0), m_sourceHeight(0), m_binning(1)
+{
+  m_region.x = m_region.y = m_region.width = m_region.height = 0;
+}
+
+ImageConverter::~ImageConverter()
+{
+}
+
+bool ImageConverter::configure(const int sourceWidth, const int sourceHeight, const ImageRegion& region, const int binning)
+{
+  if (binning != 1 && binning != 2 && binning != 4) {
+    return false;
+  }
+  if (region.x < 0 || region.y < 0 || region.x >= sourceWidth || region.y >= sourceHeight ||
+      region.width < 0 || region.height < 0) {
+    return false;
+  }
+  m_sourceWidth = sourceWidth;
+  m_sourceHeight = sourceHeight;
+  m_binning = binning;
+  m_region = region;
+  if (m_region.width == 0 || m_region.x + m_region.width > sourceWidth) {
+    m_region.width = sourceWidth - m_region.x;
+  }
+  if (m_region.height == 0 || m_region.y + m_region.height > sourceHeight) {
+    m_region.height = sourceHeight - m_region.y;
+  }
+  m_region.width -= m_region.width % binning;
+  m_region.height -= m_region.height % binning;
+  if (m_region.width == 0 || m_region.height == 0) {
+    return false;
+  }
+  if (binning > 1) {
+    m_rows.resize(m_region.width * 3);
+    m_sum.resize(m_region.width * 3);
+  } else {
+    m_rows.clear();
+    m_sum.clear();
+  }
+  return true;
+}
+
+template<class T, class Converter>
+static void convertRegion(const T* src, const int sourceWidth, const int sourceHeight, const ImageRegion& region,
+			  const int binning, Converter convertRow, uint8_t* rows, uint16_t* sum, uint8_t* dst,
+			  const int dstStride) {
+  const int n = region.width * 3;
+  const int stride = dstStride > 0 ? dstStride : n / binning;
+  for(int r = 0;r < region.height / binning;r++) {
+    if (binning == 1) {
+      // Output rows are counted from the top, V-REP rows from the bottom.
+      int y = sourceHeight - 1 - (region.y + r);
+      convertRow(src + (y * sourceWidth + region.x) * 3, dst + r * stride, region.width);
+      continue;
+    }
+    memset(sum, 0, n * sizeof(uint16_t));
+    for(int k = 0;k < binning;k++) {
+      int y = sourceHeight - 1 - (region.y + r * binning + k);
+      convertRow(src + (y * sourceWidth + region.x) * 3, rows, region.width);
+      accumulateRow(rows, sum, n);
+    }
+    binRow(sum, region.width, binning, rows, dst + r * stride);
+  }
+}
+
+void ImageConverter::convert(const float* src, uint8_t* dst, const int dstStride)
+{
+  convertRegion(src, m_sourceWidth, m_sourceHeight, m_region, m_binning, kernel().convertRow,
+		m_binning > 1 ? &m_rows[0] : NULL, m_binning > 1 ? &m_sum[0] : NULL, dst, dstStride);
+}
+
+void ImageConverter::convert(const uint8_t* src, uint8_t* dst, const int dstStride)
+{
+  convertRegion(src, m_sourceWidth, m_sourceHeight, m_region, m_binning, kernel().convertByteRow,
+		m_binning > 1 ? &m_rows[0] : NULL, m_binning > 1 ? &m_sum[0] : NULL, dst, dstStride);
+}
+
+const char* imageConversionKernel() {
+  return kernel().name;
+}
@@ -0,0 +1,220 @@
+#include "ImageEncoder.h"
+#include <string.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+
+#ifdef RTC_USE_JPEG
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+
+#ifdef RTC_USE_PNG
+#include <png.h>
+#endif
+
+#ifdef RTC_USE_JPEG
+/**
+ * libjpeg destination which appends to a std::vector, so the output
+ * buffer is reused between frames.
+ */
+struct VectorDestination {
+  struct jpeg_destination_mgr pub;
+  std::vector<uint8_t>* out;
+};
+
+static const size_t JPEG_BLOCK = 64 * 1024;
+
+static void initDestination(j_compress_ptr cinfo) {
+  VectorDestination* dest = (VectorDestination*)cinfo->dest;
+  dest->out->resize(JPEG_BLOCK);
+  dest->pub.next_output_byte = &(*dest->out)[0];
+  dest->pub.free_in_buffer = dest->out->size();
+}
+
+static boolean emptyOutputBuffer(j_compress_ptr cinfo) {
+  VectorDestination* dest = (VectorDestination*)cinfo->dest;
+  size_t used = dest->out->size();
+  dest->out->resize(used + JPEG_BLOCK);
+  dest->pub.next_output_byte = &(*dest->out)[used];
+  dest->pub.free_in_buffer = JPEG_BLOCK;
+  return TRUE;
+}
+
+static void termDestination(j_compress_ptr cinfo) {
+  VectorDestination* dest = (VectorDestination*)cinfo->dest;
+  dest->out->resize(dest->out->size() - dest->pub.free_in_buffer);
+}
+
+struct JpegError {
+  struct jpeg_error_mgr pub;
+  jmp_buf jump;
+};
+
+static void jpegErrorExit(j_common_ptr cinfo) {
+  JpegError* err = (JpegError*)cinfo->err;
+  longjmp(err->jump, 1);
+}
+#endif
+
+bool encodeJpeg(const uint8_t* image, const int width, const int height, const int channels,
+		const int quality, std::vector<uint8_t>& out) {
+#ifdef RTC_USE_JPEG
+  struct jpeg_compress_struct cinfo;
+  JpegError err;
+  VectorDestination dest;
+#ifndef JCS_EXTENSIONS
+  std::vector<uint8_t> row(channels == 3 ? width * 3 : 0);
+#endif
+
+  cinfo.err = jpeg_std_error(&err.pub);
+  err.pub.error_exit = jpegErrorExit;
+  if (setjmp(err.jump)) {
+    jpeg_destroy_compress(&cinfo);
+    return false;
+  }
+  jpeg_create_compress(&cinfo);
+  dest.pub.init_destination = initDestination;
+  dest.pub.empty_output_buffer = emptyOutputBuffer;
+  dest.pub.term_destination = termDestination;
+  dest.out = &out;
+  cinfo.dest = &dest.pub;
+
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = channels;
+#ifdef JCS_EXTENSIONS
+  cinfo.in_color_space = channels == 3 ? JCS_EXT_BGR : JCS_GRAYSCALE;
+#else
+  cinfo.in_color_space = channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+#endif
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW line = (JSAMPROW)(image + cinfo.next_scanline * width * channels);
+#ifndef JCS_EXTENSIONS
+    if (channels == 3) {
+      for(int i = 0;i < width;i++) {
+	row[i*3+0] = line[i*3+2];
+	row[i*3+1] = line[i*3+1];
+	row[i*3+2] = line[i*3+0];
+      }
+      line = &row[0];
+    }
+#endif
+    jpeg_write_scanlines(&cinfo, &line, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  return true;
+#else
+  return false;
+#endif
+}
+
+#ifdef RTC_USE_PNG
+static void pngWrite(png_structp png, png_bytep data, png_size_t length) {
+  std::vector<uint8_t>* out = (std::vector<uint8_t>*)png_get_io_ptr(png);
+  out->insert(out->end(), data, data + length);
+}
+
+static void pngFlush(png_structp png) {
+}
+#endif
+
+bool encodePng(const uint8_t* image, const int width, const int height, const int channels,
+	       const int compression, std::vector<uint8_t>& out) {
+#ifdef RTC_USE_PNG
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png == NULL) {
+    return false;
+  }
+  png_infop info = png_create_info_struct(png);
+  if (info == NULL || setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    return false;
+  }
+  out.clear();
+  png_set_write_fn(png, &out, pngWrite, pngFlush);
+  png_set_compression_level(png, compression);
+  png_set_IHDR(png, info, width, height, 8, channels == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY,
+	       PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+  if (channels == 3) {
+    png_set_bgr(png);
+  }
+  for(int i = 0;i < height;i++) {
+    png_write_row(png, (png_bytep)(image + i * width * channels));
+  }
+  png_write_end(png, NULL);
+  png_destroy_write_struct(&png, &info);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool isImageFormatSupported(const std::string& format) {
+  if (format == "bitmap") {
+    return true;
+  }
+#ifdef RTC_USE_JPEG
+  if (format == "jpeg") {
+    return true;
+  }
+#endif
+#ifdef RTC_USE_PNG
+  if (format == "png") {
+    return true;
+  }
+#endif
+  return false;
+}
+
+
+ImageEncodeWorker::ImageEncodeWorker(RTC::OutPort<RTC::CameraImage>& port) :
+  m_port(port), m_format("jpeg"), m_quality(90), m_compression(6), m_failed(0)
+{
+}
+
+ImageEncodeWorker::~ImageEncodeWorker()
+{
+  stop();
+}
+
+void ImageEncodeWorker::configure(const std::string& format, const int quality, const int compression)
+{
+  m_format = format;
+  m_quality = quality;
+  m_compression = compression;
+  m_failed = 0;
+  m_image.format = format.c_str();
+}
+
+void ImageEncodeWorker::process(EncodeJob& job)
+{
+  bool ok = false;
+  if (m_format == "jpeg") {
+    ok = encodeJpeg(&job.image[0], job.width, job.height, job.channels, m_quality, m_buffer);
+  } else if (m_format == "png") {
+    ok = encodePng(&job.image[0], job.width, job.height, job.channels, m_compression, m_buffer);
+  }
+  if (!ok) {
+    m_failed++;
+    return;
+  }
+
+  long sec = floor(job.time);
+  long nsec = (job.time - sec) * 1000*1000*1000;
+  m_image.tm.sec = sec;
+  m_image.tm.nsec = nsec;
+  m_image.width = job.width;
+  m_image.height = job.height;
+  m_image.bpp = 8 * job.channels;
+  m_image.fDiv = 1.0;
+  m_image.pixels.length(m_buffer.size());
+  memcpy(m_image.pixels.get_buffer(), &m_buffer[0], m_buffer.size());
+  m_port.write(m_image);
+}
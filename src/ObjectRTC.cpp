@@ -35,11 +35,18 @@ static const char* objectrtc_spec[] =
     //"conf.default.minObject", "0.3",
     //    "conf.default.objectHandle", "-1",
     //"conf.default.activeJointNames", "[]",
+    "conf.default.publishMode", "always",
+    "conf.default.publishDeadband", "0.0",
+    "conf.default.publishKeepAlive", "1.0",
     // Widget
     "conf.__widget__.objectName", "text",
     //"conf.__widget__.objectHandle", "text",
     "conf.__widget__.activeJointNames", "text",
+    "conf.__widget__.publishMode", "radio",
+    "conf.__widget__.publishDeadband", "text",
+    "conf.__widget__.publishKeepAlive", "text",
     // Constraints
+    "conf.__constraints__.publishMode", "(always,onChange)",
     ""
   };
 // </rtc-template>
@@ -51,8 +58,9 @@ static const char* objectrtc_spec[] =
 ObjectRTC::ObjectRTC(RTC::Manager* manager)
     // <rtc-template block="initializer">
   : RTC::DataFlowComponentBase(manager),
-    m_poseOut("pose", m_pose)
+    m_poseOut("pose", m_pose),
     // </rtc-template>
+    m_allocationCheck("ObjectRTC")
 {
 }
 
@@ -85,6 +93,9 @@ RTC::ReturnCode_t ObjectRTC::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("objectName", m_objectName, "none");
+  bindParameter("publishMode", m_publishMode, "always");
+  bindParameter("publishDeadband", m_publishDeadband, "0.0");
+  bindParameter("publishKeepAlive", m_publishKeepAlive, "1.0");
   //bindParameter("geometry_offset", m_offsetStr, "0,0,0,0,0,0");
   //bindParameter("maxObject", m_maxObject, "30.0");
   //bindParameter("minObject", m_minObject, "0.3");
@@ -138,11 +149,13 @@ RTC::ReturnCode_t ObjectRTC::onShutdown(RTC::UniqueId ec_id)
 RTC::ReturnCode_t ObjectRTC::onActivated(RTC::UniqueId ec_id)
 {
   std::cout << " - Activating ObjectRTC: " << m_objectName << std::endl;
+  m_publishFilter.configure(m_publishMode, m_publishDeadband, m_publishKeepAlive);
   return RTC::RTC_OK;
 }
 
 RTC::ReturnCode_t ObjectRTC::onDeactivated(RTC::UniqueId ec_id)
 {
+  m_allocationCheck.reset();
   return RTC::RTC_OK;
 }
 
@@ -155,6 +168,7 @@ union float_byte {
 
 RTC::ReturnCode_t ObjectRTC::onExecute(RTC::UniqueId ec_id)
 {
+	m_allocationCheck.begin();
 	simFloat position[3];
 	simFloat orientation[3];
 
@@ -200,7 +214,11 @@ RTC::ReturnCode_t ObjectRTC::onExecute(RTC::UniqueId ec_id)
 	m_pose.data.orientation.r = orientation[0];
 	m_pose.data.orientation.p = orientation[1];
 	m_pose.data.orientation.y = orientation[2];
-	m_poseOut.write();
+	double values[6] = {position[0], position[1], position[2], orientation[0], orientation[1], orientation[2]};
+	m_allocationCheck.end(time);
+	if (m_publishFilter.check(values, 6, time)) {
+		m_poseOut.write();
+	}
 	return RTC::RTC_OK;
 }
 
@@ -0,0 +1,135 @@
+#include "PointCloudFilter.h"
+#include "PackedPointCloud.h"
+#include <string.h>
+#include <math.h>
+#include <coil/Time.h>
+
+PointCloudFilterWorker::PointCloudFilterWorker(RTC::OutPort<RTC::PointCloud>& cloudPort,
+					       RTC::OutPort<RTC::TimedOctetSeq>& packedPort) :
+  m_cloudPort(cloudPort), m_packedPort(packedPort), m_packedFormat(false),
+  m_nearClipping(0), m_farClipping(0), m_inputPoints(0), m_outputPoints(0)
+{
+}
+
+PointCloudFilterWorker::~PointCloudFilterWorker()
+{
+  stop();
+}
+
+void PointCloudFilterWorker::configure(const bool packed, const int maxPoints, const float voxelSize,
+				       const float nearClipping, const float farClipping)
+{
+  m_packedFormat = packed;
+  m_nearClipping = nearClipping;
+  m_farClipping = farClipping;
+  m_grid.configure(maxPoints, voxelSize);
+  m_inputPoints = 0;
+  m_outputPoints = 0;
+  // Sized for the largest cloud, so shorter clouds do not reallocate.
+  if (packed) {
+    m_packed.data.length(sizeof(PackedPointCloudHeader) + maxPoints * PACKED_POINT_SIZE);
+    m_cloud.points.length(0);
+  } else {
+    m_cloud.points.length(maxPoints);
+    m_packed.data.length(0);
+  }
+}
+
+void PointCloudFilterWorker::process(PointCloudJob& job)
+{
+  const int count = m_grid.filter(&job.points[0], job.count, &job.points[0]);
+  m_inputPoints += job.count;
+  m_outputPoints += count;
+
+  long sec = floor(job.time);
+  long nsec = (job.time - sec) * 1000*1000*1000;
+  if (m_packedFormat) {
+    PackedPointCloudHeader header;
+    memcpy(header.magic, "PPC1", 4);
+    header.width = count;
+    header.height = 1;
+    header.pointSize = PACKED_POINT_SIZE;
+    header.flags = job.flags;
+    header.nearClipping = m_nearClipping;
+    header.farClipping = m_farClipping;
+    header.reserved = 0;
+    memcpy(header.pose, job.pose, sizeof(header.pose));
+    m_packed.data.length(sizeof(header) + count * PACKED_POINT_SIZE);
+    memcpy(m_packed.data.get_buffer(), &header, sizeof(header));
+    memcpy(m_packed.data.get_buffer() + sizeof(header), &job.points[0], count * PACKED_POINT_SIZE);
+    m_packed.tm.sec = sec;
+    m_packed.tm.nsec = nsec;
+    m_packedPort.write(m_packed);
+    return;
+  }
+  m_cloud.points.length(count);
+  for(int i = 0;i < count;i++) {
+    const float* p = &job.points[i * 4];
+    uint32_t rgb;
+    memcpy(&rgb, p + 3, 4);
+    m_cloud.points[i].point.x = p[0];
+    m_cloud.points[i].point.y = p[1];
+    m_cloud.points[i].point.z = p[2];
+    m_cloud.points[i].colour.r = (rgb >> 16) & 0xFF;
+    m_cloud.points[i].colour.g = (rgb >> 8) & 0xFF;
+    m_cloud.points[i].colour.b = rgb & 0xFF;
+  }
+  m_cloud.tm.sec = sec;
+  m_cloud.tm.nsec = nsec;
+  m_cloudPort.write(m_cloud);
+}
+
+
+PointCloudEncodeWorker::PointCloudEncodeWorker(RTC::OutPort<RTC::TimedOctetSeq>& octreePort,
+					       RTC::OutPort<RTC::TimedDoubleSeq>& statsPort) :
+  m_octreePort(octreePort), m_statsPort(statsPort), m_resolution(0.01f),
+  m_rawBytes(0), m_encodedBytes(0), m_encodeTime(0)
+{
+}
+
+PointCloudEncodeWorker::~PointCloudEncodeWorker()
+{
+  stop();
+}
+
+void PointCloudEncodeWorker::configure(const int maxPoints, const float resolution)
+{
+  m_resolution = resolution;
+  m_encoder.configure(maxPoints, m_buffer);
+  m_octree.data.length(m_buffer.capacity());
+  m_stats.data.length(5);
+  m_rawBytes = 0;
+  m_encodedBytes = 0;
+  m_encodeTime = 0;
+}
+
+void PointCloudEncodeWorker::process(PointCloudJob& job)
+{
+  coil::TimeValue begin = coil::gettimeofday();
+  OctreeCloudHeader header;
+  header.flags = job.flags;
+  memcpy(header.pose, job.pose, sizeof(header.pose));
+  const size_t size = m_encoder.encode(&job.points[0], job.count, m_resolution, header, m_buffer);
+  const double encodeTime = (double)(coil::gettimeofday() - begin);
+  const double rawBytes = sizeof(PackedPointCloudHeader) + job.count * PACKED_POINT_SIZE;
+  m_rawBytes += rawBytes;
+  m_encodedBytes += size;
+  m_encodeTime += encodeTime;
+
+  long sec = floor(job.time);
+  long nsec = (job.time - sec) * 1000*1000*1000;
+  m_octree.data.length(size);
+  memcpy(m_octree.data.get_buffer(), &m_buffer[0], size);
+  m_octree.tm.sec = sec;
+  m_octree.tm.nsec = nsec;
+  m_octreePort.write(m_octree);
+
+  m_stats.data[0] = rawBytes / size;
+  m_stats.data[1] = encodeTime * 1000;
+  m_stats.data[2] = job.count;
+  m_stats.data[3] = header.leaves;
+  m_stats.data[4] = size;
+  m_stats.tm.sec = sec;
+  m_stats.tm.nsec = nsec;
+  m_statsPort.write(m_stats);
+}
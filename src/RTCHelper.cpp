@@ -8,12 +8,17 @@
 #include "VREPRTC.h"
 #include "RangeRTC.h"
 #include "CameraRTC.h"
+#include "CameraArrayRTC.h"
+#include "StereoCameraRTC.h"
 #include "AccelerometerRTC.h"
 #include "GyroRTC.h"
 #include "DepthRTC.h"
 #include "RobotRTC.h"
+#include "RobotFleetRTC.h"
 #include "ObjectRTC.h"
 #include "RTCHelper.h"
+#include "StepListener.h"
+#include "VisionSensorManager.h"
 //#include "v_repExtRTC.h"
 #include "v_repLib.h"
 
@@ -50,8 +55,11 @@ int ManagerRunner::svc() {
 void MyModuleInit(RTC::Manager* manager)
 {
   RobotRTCInit(manager);
+  RobotFleetRTCInit(manager);
   RangeRTCInit(manager);
   CameraRTCInit(manager);
+  CameraArrayRTCInit(manager);
+  StereoCameraRTCInit(manager);
   AccelerometerRTCInit(manager);
   GyroRTCInit(manager);
   DepthRTCInit(manager);
@@ -168,6 +176,12 @@ int spawnRangeRTC(std::string& key, std::string& arg) {
 
 
 int spawnCameraRTC(std::string& key, std::string& arg) {
+  if (key.find('|') != std::string::npos) {
+    return spawnStereoCameraRTC(key, arg);
+  }
+  if (key.find_first_of(",*?") != std::string::npos) {
+    return spawnCameraArrayRTC(key, arg);
+  }
   std::cout << " -- Spawning Camera RTC (objectName = " << key << ")" << std::endl;
   simInt objHandle = simGetObjectHandle(key.c_str());
   if (objHandle == -1) {
@@ -326,6 +340,9 @@ int spawnObjectRTC(std::string& key, std::string& arg) {
 
 
 int spawnRobotRTC(std::string& key, std::string &arg) {
+  if (key.find_first_of(",*?") != std::string::npos) {
+    return spawnRobotFleetRTC(key, arg);
+  }
   std::cout << " -- Spawning RTC (objectName = " << key << ")" << std::endl;
   simInt objHandle = simGetObjectHandle(key.c_str());
   if (objHandle == -1) {
@@ -374,15 +391,223 @@ int spawnRobotRTC(std::string& key, std::string &arg) {
   return 0;
 }
 
+static bool matchPattern(const char* pattern, const char* str) {
+  if (*pattern == '\0') {
+    return *str == '\0';
+  }
+  if (*pattern == '*') {
+    return matchPattern(pattern+1, str) || (*str != '\0' && matchPattern(pattern, str+1));
+  }
+  if (*str != '\0' && (*pattern == '?' || *pattern == *str)) {
+    return matchPattern(pattern+1, str+1);
+  }
+  return false;
+}
+
+/**
+ * Replace the characters which split the createComponent argument
+ * ("Name?key=value&...") in a configuration value, so a key with glob
+ * patterns can be passed as objectName.
+ */
+static std::string argumentValue(const std::string& value) {
+  std::string escaped = value;
+  for (size_t i = 0;i < escaped.size();i++) {
+    if (escaped[i] == '?' || escaped[i] == '&' || escaped[i] == '=') {
+      escaped[i] = '_';
+    }
+  }
+  return escaped;
+}
+
+/**
+ * Expand the comma separated names and glob patterns of key. Patterns
+ * match models, or objects of objectType when it is given.
+ */
+static void findModels(const std::string& key, std::vector<std::string>& modelNames, const simInt objectType = -1) {
+  std::vector<std::string> tokens;
+  splitList(key, tokens);
+  for (int i = 0;i < tokens.size();i++) {
+    if (tokens[i].find_first_of("*?") == std::string::npos) {
+      modelNames.push_back(tokens[i]);
+      continue;
+    }
+    simInt h;
+    for (int j = 0;(h = simGetObjects(j, objectType < 0 ? sim_handle_all : objectType)) >= 0;j++) {
+      if (objectType < 0 && (simGetModelProperty(h) & sim_modelproperty_not_model)) {
+	continue;
+      }
+      simChar* name = simGetObjectName(h);
+      if (name == NULL) {
+	continue;
+      }
+      if (matchPattern(tokens[i].c_str(), name)) {
+	modelNames.push_back(name);
+      }
+      simReleaseBuffer(name);
+    }
+  }
+}
+
+int spawnCameraArrayRTC(std::string& key, std::string& arg) {
+  std::cout << " -- Spawning Camera Array RTC (objectName = " << key << ")" << std::endl;
+  std::vector<std::string> cameraNames;
+  findModels(key, cameraNames, sim_object_visionsensor_type);
+  if (cameraNames.size() == 0) {
+    std::cout << " --- No vision sensor matches." << std::endl;
+    return -1;
+  }
+
+  std::ostringstream name_oss;
+  std::ostringstream handle_oss;
+  for (int i = 0;i < cameraNames.size();i++) {
+    simInt objHandle = simGetObjectHandle(cameraNames[i].c_str());
+    if (objHandle == -1) {
+      std::cout << " --- failed to get object handle of " << cameraNames[i] << std::endl;
+      return -1;
+    }
+    if (simGetObjectType(objHandle) != sim_object_visionsensor_type) {
+      std::cout << " --- Object " << cameraNames[i] << " is not Vision Sensor Type." << std::endl;
+      return -1;
+    }
+    if (i != 0) {
+      name_oss << ",";
+      handle_oss << ",";
+    }
+    name_oss << cameraNames[i];
+    handle_oss << objHandle;
+  }
+  std::cout << " --- cameras = " << name_oss.str() << std::endl;
+
+  std::ostringstream arg_oss;
+  arg_oss << "CameraArrayRTC?"
+	  << "exec_cxt.periodic.type=" << "SynchExtTriggerEC" << "&"
+	  << "conf.default.objectName=" << argumentValue(key) << "&"
+	  << "conf.__innerparam.objectName=" << argumentValue(key) << "&"
+	  << "conf.__innerparam.objectNames=" << name_oss.str() << "&"
+	  << "conf.__innerparam.objectHandles=" << handle_oss.str() << "&"
+	  << arg;
+  RTObject_impl* cmp = RTC::Manager::instance().createComponent(arg_oss.str().c_str());
+  if (cmp == NULL) {
+    std::cout << " --- createComponent failed." << std::endl;
+    return -1;
+  }
+  robotContainer.push(cmp->getObjRef(), key);
+  return 0;
+}
+
+int spawnRobotFleetRTC(std::string& key, std::string& arg) {
+  std::cout << " -- Spawning Fleet RTC (objectName = " << key << ")" << std::endl;
+  std::vector<std::string> modelNames;
+  findModels(key, modelNames);
+  if (modelNames.size() == 0) {
+    std::cout << " --- No robot model matches." << std::endl;
+    return -1;
+  }
+
+  std::ostringstream name_oss;
+  std::ostringstream count_oss;
+  std::ostringstream handle_oss;
+  for (int i = 0;i < modelNames.size();i++) {
+    simInt objHandle = simGetObjectHandle(modelNames[i].c_str());
+    if (objHandle == -1) {
+      std::cout << " --- failed to get object handle of " << modelNames[i] << std::endl;
+      return -1;
+    }
+    std::vector<simInt> jointHandles;
+    std::vector<std::string> jointNames;
+    getChildren(objHandle, jointHandles, jointNames, sim_object_joint_type);
+
+    if (i != 0) {
+      name_oss << ",";
+      count_oss << ",";
+    }
+    name_oss << modelNames[i];
+    count_oss << jointHandles.size();
+    for (int j = 0;j < jointHandles.size();j++) {
+      if (handle_oss.tellp() > 0) {
+	handle_oss << ",";
+      }
+      handle_oss << jointHandles[j];
+    }
+  }
+  std::cout << " --- robots = " << name_oss.str() << std::endl;
+  std::cout << " --- jointCounts = " << count_oss.str() << std::endl;
+
+  std::ostringstream arg_oss;
+  arg_oss << "RobotFleetRTC?"
+	  << "exec_cxt.periodic.type=" << "SynchExtTriggerEC" << "&"
+	  << "conf.default.objectName=" << argumentValue(key) << "&"
+	  << "conf.__innerparam.objectName=" << argumentValue(key) << "&"
+	  << "conf.__innerparam.robotNames=" << name_oss.str() << "&"
+	  << "conf.__innerparam.jointCounts=" << count_oss.str() << "&"
+	  << "conf.__innerparam.allHandles=" << handle_oss.str() << "&"
+	  << arg;
+  RTObject_impl* cmp = RTC::Manager::instance().createComponent(arg_oss.str().c_str());
+  if (cmp == NULL) {
+    std::cout << " --- createComponent failed." << std::endl;
+    return -1;
+  }
+  robotContainer.push(cmp->getObjRef(), key);
+  return 0;
+}
+
+/**
+ * key is "leftSensor|rightSensor".
+ */
+int spawnStereoCameraRTC(std::string& key, std::string& arg) {
+  std::cout << " -- Spawning Stereo Camera RTC (objectName = " << key << ")" << std::endl;
+  std::string::size_type sep = key.find('|');
+  std::string names[2] = {key.substr(0, sep), key.substr(sep + 1)};
+  simInt handles[2];
+  for (int i = 0;i < 2;i++) {
+    handles[i] = simGetObjectHandle(names[i].c_str());
+    if (handles[i] == -1) {
+      std::cout << " --- failed to get object handle of " << names[i] << std::endl;
+      return -1;
+    }
+    if (simGetObjectType(handles[i]) != sim_object_visionsensor_type) {
+      std::cout << " --- Object " << names[i] << " is not Vision Sensor Type." << std::endl;
+      return -1;
+    }
+  }
+
+  std::ostringstream arg_oss;
+  arg_oss << "StereoCameraRTC?"
+	  << "exec_cxt.periodic.type=" << "SynchExtTriggerEC" << "&"
+	  << "conf.default.objectName=" << key << "&"
+	  << "conf.__innerparam.objectName=" << key << "&"
+	  << "conf.__innerparam.objectNames=" << names[0] << "," << names[1] << "&"
+	  << "conf.__innerparam.objectHandles=" << handles[0] << "," << handles[1] << "&"
+	  << arg;
+  RTObject_impl* cmp = RTC::Manager::instance().createComponent(arg_oss.str().c_str());
+  if (cmp == NULL) {
+    std::cout << " --- createComponent failed." << std::endl;
+    return -1;
+  }
+  robotContainer.push(cmp->getObjRef(), key);
+  return 0;
+}
+
 void startRTCs() {
   robotContainer.start();
 }
 
 void stopRTCs() {
   robotContainer.stop();
+  if (visionSensors.fetchCount() > 0) {
+    std::cout << " - Vision sensor buffers: " << visionSensors.fetchCount() << " fetched, "
+	      << visionSensors.hitCount() << " shared." << std::endl;
+  }
+  visionSensors.clear();
+}
+
+void stepRTCs(const float time, const float timeStep) {
+  stepListeners.notify(time, timeStep);
 }
 
 void tickRTCs(const float interval) {
+  // simHandleVisionSensor must run on the V-REP main thread, not in onExecute.
+  visionSensors.renderRequested(simGetSimulationTime());
   robotContainer.tick(interval);
 }
 
@@ -33,13 +33,16 @@ static const char* rangertc_spec[] =
     "conf.default.geometry_offset", "0,0,0,0,0,0",
 	"conf.default.maxRange", "30.0",
 	"conf.default.minRange", "0.3",
+    "conf.default.drainPolicy", "latest",
     //    "conf.default.objectHandle", "-1",
     //"conf.default.activeJointNames", "[]",
     // Widget
     "conf.__widget__.objectName", "text",
     //"conf.__widget__.objectHandle", "text",
     "conf.__widget__.activeJointNames", "text",
+    "conf.__widget__.drainPolicy", "radio",
     // Constraints
+    "conf.__constraints__.drainPolicy", "(latest,all,average)",
     ""
   };
 // </rtc-template>
@@ -51,8 +54,13 @@ static const char* rangertc_spec[] =
 RangeRTC::RangeRTC(RTC::Manager* manager)
     // <rtc-template block="initializer">
   : RTC::DataFlowComponentBase(manager),
-    m_rangeOut("range", m_range)
+    m_rangeOut("range", m_range),
     // </rtc-template>
+    m_allocationCheck("RangeRTC"),
+    m_publishedScans(0),
+    m_droppedMessages(0),
+    m_staleMessages(0),
+    m_leftMessages(0)
 {
 }
 
@@ -88,6 +96,7 @@ RTC::ReturnCode_t RangeRTC::onInitialize()
   bindParameter("geometry_offset", m_offsetStr, "0,0,0,0,0,0");
   bindParameter("maxRange", m_maxRange, "30.0");
   bindParameter("minRange", m_minRange, "0.3");
+  bindParameter("drainPolicy", m_drainPolicy, "latest");
   // </rtc-template>
 
 
@@ -165,6 +174,11 @@ RTC::ReturnCode_t RangeRTC::onActivated(RTC::UniqueId ec_id)
   m_range.config.minRange = m_minRange;
   m_range.config.maxAngle = 0.0;
   m_range.config.minAngle = 0.0;
+  std::cout << " -- Drain Policy = " << m_drainPolicy << std::endl;
+  m_publishedScans = 0;
+  m_droppedMessages = 0;
+  m_staleMessages = 0;
+  m_leftMessages = 0;
   return RTC::RTC_OK;
 }
 
@@ -179,81 +193,125 @@ bool RangeRTC::isInitRangeConfig() {
 
 RTC::ReturnCode_t RangeRTC::onDeactivated(RTC::UniqueId ec_id)
 {
+  std::cout << " - Deactivated RangeRTC: " << m_publishedScans << " scans published, "
+	    << m_droppedMessages << " messages dropped, " << m_staleMessages << " stale." << std::endl;
+  m_allocationCheck.reset();
   return RTC::RTC_OK;
 }
 
 
-union float_byte {
-  float float_value;
-  unsigned char byte_value[4];
-};
-
-RTC::ReturnCode_t RangeRTC::onExecute(RTC::UniqueId ec_id)
+void RangeRTC::prepareRanges(const int ray_size)
 {
-  simInt bufSize;
-  simChar* pBuffer = simTubeRead(m_tubeHandle, &bufSize);
-  //std::cout << "ret == " << bufSize << std::endl;
-  if (pBuffer == NULL) {
-    // std::cout << " - RangeData: NULL. But this is not error." << std::endl;
-    return RTC::RTC_OK;
+  if(ray_size != (int)m_range.ranges.length()) {
+    m_range.ranges.length(ray_size);
+    m_range.config.maxAngle = 0.0;
+    m_range.config.minAngle = 0.0;
   }
-  float_byte buffer;
-  int data_size = bufSize / 4;
-  int ray_size = data_size / 3;
+  // The angles are fixed, only the first scans with enough points compute them.
+  if (!isInitRangeConfig() && m_scan.calibrate()) {
+    m_range.config.angularRes = m_scan.angularResolution();
+    double full_range = m_range.config.angularRes * (ray_size-1);
+    m_range.config.minAngle = -full_range/2;
+    m_range.config.maxAngle = full_range/2;
+  }
+}
 
+
+RTC::ReturnCode_t RangeRTC::onExecute(RTC::UniqueId ec_id)
+{
+  m_allocationCheck.begin();
   float time = simGetSimulationTime();
   long sec = floor(time);
   long nsec = (time - sec) * 1000*1000*1000;
   m_range.tm.sec = sec;
   m_range.tm.nsec = nsec;
-  if(ray_size != m_range.ranges.length()) {
-    m_range.ranges.length(ray_size);
-  }
 
-  bool previous_point_is_valid = false;
-  double previous_angle = 0.0;
-  for(int i = 0;i < ray_size;i++) {
-    float x[3];
-    for(int j = 0;j < 3;j++) {
-      for(int k = 0;k < 4;k++) {
-	buffer.byte_value[k] = pBuffer[i*4*3 + j*4 + k];
+  // Drain the tube every tick, so the published scan is never more than
+  // one tick behind the script. Bounded by the tube size in case the
+  // script keeps writing.
+  const bool publishAll = (m_drainPolicy == "all");
+  const bool average = (m_drainPolicy == "average");
+  int messages = 0;
+  int averaged = 0;
+  simChar* pLatest = NULL;
+  simInt latestSize = 0;
+  while(messages < m_bufferSize) {
+    simInt bufSize;
+    simChar* pBuffer = simTubeRead(m_tubeHandle, &bufSize);
+    if (pBuffer == NULL) {
+      break;
+    }
+    messages++;
+    if (!publishAll && !average) {
+      // latest: only the newest message is decoded.
+      if (pLatest != NULL) {
+	simReleaseBuffer(pLatest);
+	m_droppedMessages++;
       }
-      x[j] = buffer.float_value;
+      pLatest = pBuffer;
+      latestSize = bufSize;
+      continue;
+    }
+    // The payload is copied at once, so the tube buffer goes back right away.
+    int ray_size = m_scan.decode(pBuffer, bufSize);
+    simReleaseBuffer(pBuffer);
+    prepareRanges(ray_size);
+    if (publishAll) {
+      m_scan.distances(m_range.config.maxRange, m_range.ranges.get_buffer());
+      m_publishedScans++;
+      m_rangeOut.write();
+      continue;
+    }
+    if (averaged > 0 && ray_size != (int)m_rangeHits.size()) {
+      m_droppedMessages += averaged;
+      averaged = 0;
+    }
+    if (averaged == 0) {
+      m_rangeSum.assign(ray_size, 0.0);
+      m_rangeHits.assign(ray_size, 0);
+      m_scanRanges.resize(ray_size);
     }
-    //std::cout << "data(" << i << ")=(" << x[0] << ", " << x[1] << ", " << x[2] << ")";
-    
-    double angle = atan2(x[1], x[0]);
-    double distance = sqrt(x[1]*x[1] + x[0]*x[0]);
-    //std::cout << " --- " << distance << "/rad=" << angle << ", deg=" << angle / 3.1415926 * 180.0 << std::endl;
-
-    const double epsilon = 0.001;
-    bool current_point_is_valid = distance < epsilon ? false : true;
-
-	if (distance > m_range.config.maxRange) {
-		m_range.ranges[i] = m_range.config.maxRange;
-	} else {
-	    m_range.ranges[i] = distance;
-	}
-    //m_range.ranges[i] = distance;
-
-    if (!isInitRangeConfig()) {
-      if (previous_point_is_valid && current_point_is_valid) {
-	m_range.config.angularRes = angle - previous_angle;
+    m_scan.distances(m_range.config.maxRange, &m_scanRanges[0]);
+    for(int i = 0;i < ray_size;i++) {
+      // Rays without a detected point read 0 and do not pull the mean down.
+      if (m_scanRanges[i] > 0) {
+	m_rangeSum[i] += m_scanRanges[i];
+	m_rangeHits[i]++;
       }
-      previous_angle = angle;
-      previous_point_is_valid = current_point_is_valid;
     }
-
+    averaged++;
+  }
+  // The tube is first in first out, so the messages left unread by the
+  // previous tick are the first ones read now.
+  m_staleMessages += messages < m_leftMessages ? messages : m_leftMessages;
+  m_leftMessages = 0;
+  if (messages == m_bufferSize) {
+    simInt left = 0, written = 0;
+    if (simTubeStatus(m_tubeHandle, &left, &written) >= 0 && left > 0) {
+      m_leftMessages = left;
+    }
   }
-  ///m_range.config.angularRes = (m_range.config.maxAngle - m_range.config.minAngle) / (ray_size-1);
 
-  if (!isInitRangeConfig()) {
-    double full_range = m_range.config.angularRes * (ray_size-1);
-    m_range.config.minAngle = -full_range/2;
-    m_range.config.maxAngle = full_range/2;
+  if (publishAll) {
+    // Every message was published in the loop, the tick is checked as a whole.
+    m_allocationCheck.end(time);
+    return RTC::RTC_OK;
+  }
+  if (pLatest != NULL) {
+    int ray_size = m_scan.decode(pLatest, latestSize);
+    simReleaseBuffer(pLatest);
+    prepareRanges(ray_size);
+    m_scan.distances(m_range.config.maxRange, m_range.ranges.get_buffer());
+  } else if (averaged > 0) {
+    for(size_t i = 0;i < m_rangeHits.size();i++) {
+      m_range.ranges[i] = m_rangeHits[i] > 0 ? m_rangeSum[i] / m_rangeHits[i] : 0.0;
+    }
+  } else {
+    return RTC::RTC_OK;
   }
+  m_allocationCheck.end(time);
+  m_publishedScans++;
   m_rangeOut.write();
-  simReleaseBuffer((simChar*)pBuffer);
   
   return RTC::RTC_OK;
 }
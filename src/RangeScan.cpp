@@ -0,0 +1,90 @@
+#include "RangeScan.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RANGE_SCAN_SSE
+#include <emmintrin.h>
+#endif
+
+int RangeScan::decode(const char* payload, const int size)
+{
+  const int rays = size / (3 * sizeof(float));
+  if (rays != m_rays) {
+    m_angularResolution = 0;
+  }
+  m_rays = rays;
+  // Grows to the largest scan once, the payload itself need not be aligned.
+  if (m_points.size() < (size_t)rays * 3) {
+    m_points.resize(rays * 3);
+  }
+  if (rays > 0) {
+    memcpy(&m_points[0], payload, rays * 3 * sizeof(float));
+  }
+  return rays;
+}
+
+bool RangeScan::calibrate()
+{
+  if (isCalibrated()) {
+    return true;
+  }
+  // Same rule as before: the angle between the last two neighbour rays
+  // which both detected a point.
+  const double epsilon = 0.001;
+  bool previousValid = false;
+  double previousAngle = 0.0;
+  double resolution = 0.0;
+  for(int i = 0;i < m_rays;i++) {
+    const float* p = &m_points[i * 3];
+    const double angle = atan2(p[1], p[0]);
+    const bool valid = sqrt(p[0] * p[0] + p[1] * p[1]) >= epsilon;
+    if (previousValid && valid) {
+      resolution = angle - previousAngle;
+    }
+    previousAngle = angle;
+    previousValid = valid;
+  }
+  m_angularResolution = resolution;
+  return isCalibrated();
+}
+
+void RangeScan::distancesScalar(const double maxRange, double* ranges) const
+{
+  for(int i = 0;i < m_rays;i++) {
+    const float* p = &m_points[i * 3];
+    const double distance = sqrt(p[0] * p[0] + p[1] * p[1]);
+    ranges[i] = distance > maxRange ? maxRange : distance;
+  }
+}
+
+void RangeScan::distances(const double maxRange, double* ranges) const
+{
+  int i = 0;
+#ifdef RANGE_SCAN_SSE
+  // Four rays are three vectors (x0 y0 z0 x1, y1 z1 x2 y2, z2 x3 y3 z3),
+  // squared first and then shuffled to the x and y terms of each ray.
+  const __m128 limit = _mm_set1_ps((float)maxRange);
+  for(;i + 4 <= m_rays;i += 4) {
+    const float* p = &m_points[i * 3];
+    __m128 a = _mm_loadu_ps(p);
+    __m128 b = _mm_loadu_ps(p + 4);
+    __m128 c = _mm_loadu_ps(p + 8);
+    a = _mm_mul_ps(a, a);
+    b = _mm_mul_ps(b, b);
+    c = _mm_mul_ps(c, c);
+    __m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));  // b2 b3 c1 c2
+    __m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));  // a1 a1 b0 b0
+    __m128 xx = _mm_shuffle_ps(a, bc, _MM_SHUFFLE(2, 0, 3, 0)); // a0 a3 b2 c1
+    __m128 yy = _mm_shuffle_ps(ab, bc, _MM_SHUFFLE(3, 1, 2, 0)); // a1 b0 b3 c2
+    __m128 d = _mm_min_ps(_mm_sqrt_ps(_mm_add_ps(xx, yy)), limit);
+    _mm_storeu_pd(ranges + i, _mm_cvtps_pd(d));
+    _mm_storeu_pd(ranges + i + 2, _mm_cvtps_pd(_mm_movehl_ps(d, d)));
+  }
+#endif
+  for(;i < m_rays;i++) {
+    const float* p = &m_points[i * 3];
+    const double distance = sqrt(p[0] * p[0] + p[1] * p[1]);
+    ranges[i] = distance > maxRange ? maxRange : distance;
+  }
+}
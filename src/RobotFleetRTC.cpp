@@ -0,0 +1,341 @@
+// -*- C++ -*-
+/*!
+ * @file  RobotFleetRTC.cpp
+ * @brief Simulator Robot Fleet RTC for VREP simulator
+ *
+ * One component drives many robot models. Commands and states of all the
+ * robots are packed into single sequences in robot order, then joint order.
+ */
+
+#include "RobotFleetRTC.h"
+#include <string>
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <v_repLib.h>
+// Module specification
+// <rtc-template block="module_spec">
+static const char* robotfleetrtc_spec[] =
+  {
+    "implementation_id", "RobotFleetRTC",
+    "type_name",         "RobotFleetRTC",
+    "description",       "Simulator Robot Fleet RTC",
+    "version",           "1.0.0",
+    "vendor",            "ysuga_net",
+    "category",          "Simulator",
+    "activity_type",     "PERIODIC",
+    "kind",              "DataFlowComponent",
+    "max_instance",      "1",
+    "language",          "C++",
+    "lang_type",         "compile",
+    // Configuration variables
+    "conf.default.objectName", "none",
+    "conf.default.publishMode", "always",
+    "conf.default.publishDeadband", "0.0",
+    "conf.default.publishKeepAlive", "1.0",
+    // Widget
+    "conf.__widget__.objectName", "text",
+    "conf.__widget__.publishMode", "radio",
+    "conf.__widget__.publishDeadband", "text",
+    "conf.__widget__.publishKeepAlive", "text",
+    // Constraints
+    "conf.__constraints__.publishMode", "(always,onChange)",
+    ""
+  };
+// </rtc-template>
+
+/*!
+ * @brief constructor
+ * @param manager Maneger Object
+ */
+RobotFleetRTC::RobotFleetRTC(RTC::Manager* manager)
+    // <rtc-template block="initializer">
+  : RTC::DataFlowComponentBase(manager),
+    m_targetForceIn("targetForce", m_targetForce),
+    m_targetVelocityIn("targetVelocity", m_targetVelocity),
+    m_targetPositionIn("targetPosition", m_targetPosition),
+    m_currentForceOut("currentForce", m_currentForce),
+    m_currentVelocityOut("currentVelocity", m_currentVelocity),
+    m_currentPositionOut("currentPosition", m_currentPosition),
+    m_jointCountsOut("jointCounts", m_jointCounts),
+
+    // </rtc-template>
+    m_lastTickTime(-1.0),
+    m_allocationCheck("RobotFleetRTC")
+{
+}
+
+/*!
+ * @brief destructor
+ */
+RobotFleetRTC::~RobotFleetRTC()
+{
+}
+
+
+
+RTC::ReturnCode_t RobotFleetRTC::onInitialize()
+{
+  // Registration: InPort/OutPort/Service
+  // <rtc-template block="registration">
+  // Set InPort buffers
+  addInPort("targetForce", m_targetForceIn);
+  addInPort("targetVelocity", m_targetVelocityIn);
+  addInPort("targetPosition", m_targetPositionIn);
+  
+  // Set OutPort buffer
+  addOutPort("currentForce", m_currentForceOut);
+  addOutPort("currentVelocity", m_currentVelocityOut);
+  addOutPort("currentPosition", m_currentPositionOut);
+  addOutPort("jointCounts", m_jointCountsOut);
+  
+  // Set service provider to Ports
+  
+  // Set service consumers to Ports
+  
+  // Set CORBA Service Ports
+  
+  // </rtc-template>
+
+  // <rtc-template block="bind_config">
+  // Bind variables and configuration variable
+  bindParameter("objectName", m_objectName, "none");
+  bindParameter("publishMode", m_publishMode, "always");
+  bindParameter("publishDeadband", m_publishDeadband, "0.0");
+  bindParameter("publishKeepAlive", m_publishKeepAlive, "1.0");
+  // </rtc-template>
+
+  std::cout << " - Initializing RobotFleetRTC(" << m_properties.getProperty("conf.default.objectName") << ")" << std::endl;
+
+  splitList(m_properties.getProperty("conf.__innerparam.robotNames"), m_robotNames);
+  std::cout << " -- Robots = " << m_robotNames.size() << std::endl;
+
+  std::vector<std::string> tokens;
+  splitList(m_properties.getProperty("conf.__innerparam.jointCounts"), tokens);
+  m_jointCounts.data.length(tokens.size());
+  for(uint32_t i = 0;i < tokens.size();i++) {
+    m_jointCounts.data[i] = atoi(tokens[i].c_str());
+  }
+
+  splitList(m_properties.getProperty("conf.__innerparam.allHandles"), tokens);
+  m_jointHandle.resize(tokens.size());
+  for(uint32_t i = 0;i < tokens.size();i++) {
+    m_jointHandle[i] = atoi(tokens[i].c_str());
+  }
+  std::cout << " -- Joints = " << m_jointHandle.size() << std::endl;
+
+  m_currentPosition.data.length(m_jointHandle.size());
+  m_currentVelocity.data.length(m_jointHandle.size());
+  m_currentForce.data.length(m_jointHandle.size());
+  std::cout << " -- Initialization Ended." << std::endl;
+
+  return RTC::RTC_OK;
+}
+
+/*
+RTC::ReturnCode_t RobotFleetRTC::onFinalize()
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t RobotFleetRTC::onStartup(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t RobotFleetRTC::onShutdown(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+RTC::ReturnCode_t RobotFleetRTC::onActivated(RTC::UniqueId ec_id)
+{
+  std::cout << " - Activating RobotFleetRTC(" << m_objectName << ")" << std::endl;
+  m_positionFilter.configure(m_publishMode, m_publishDeadband, m_publishKeepAlive);
+  m_velocityFilter.configure(m_publishMode, m_publishDeadband, m_publishKeepAlive);
+  m_forceFilter.configure(m_publishMode, m_publishDeadband, m_publishKeepAlive);
+  m_lastTickTime = -1.0;
+  return RTC::RTC_OK;
+}
+
+
+RTC::ReturnCode_t RobotFleetRTC::onDeactivated(RTC::UniqueId ec_id)
+{
+  std::cout << " - Deactivated RobotFleetRTC(" << m_objectName << ")" << std::endl;
+  if (m_sizeError.total() + m_jointError.total() > 0) {
+    std::cout << " -- " << m_sizeError.total() << " invalid data size errors, "
+	      << m_jointError.total() << " joint access errors." << std::endl;
+  }
+  m_sizeError.reset();
+  m_jointError.reset();
+  m_allocationCheck.reset();
+  return RTC::RTC_OK;
+}
+
+
+bool RobotFleetRTC::checkLength(const RTC::TimedDoubleSeq& data)
+{
+  if (m_jointHandle.size() != data.data.length()) {
+    if (m_sizeError.raise(simGetSimulationTime())) {
+      std::cout << " - onExecute(" << m_objectName << "): Invalid Data number. This RTC reuqires " << m_jointHandle.size() << " data size."
+		<< " But " << data.data.length() << " data is sent (" << m_sizeError.take() << " times)." << std::endl;
+    }
+    return false;
+  }
+  return true;
+}
+
+
+RTC::ReturnCode_t RobotFleetRTC::onExecute(RTC::UniqueId ec_id)
+{
+  m_allocationCheck.begin();
+  if (m_targetPositionIn.isNew()) {
+    m_targetPositionIn.read();
+    if (!checkLength(m_targetPosition)) {
+      return RTC::RTC_ERROR;
+    }
+    for(uint32_t i = 0;i < m_targetPosition.data.length();i++) {
+      simSetJointTargetPosition(m_jointHandle[i], m_targetPosition.data[i]);
+    }
+  }
+
+  if (m_targetVelocityIn.isNew()) {
+    m_targetVelocityIn.read();
+    if (!checkLength(m_targetVelocity)) {
+      return RTC::RTC_ERROR;
+    }
+    for(uint32_t i = 0;i < m_targetVelocity.data.length();i++) {
+      simSetJointTargetVelocity(m_jointHandle[i], m_targetVelocity.data[i]);
+    }
+  }
+
+  if (m_targetForceIn.isNew()) {
+    m_targetForceIn.read();
+    if (!checkLength(m_targetForce)) {
+      return RTC::RTC_ERROR;
+    }
+    for(uint32_t i = 0;i < m_targetForce.data.length();i++) {
+      simSetJointForce(m_jointHandle[i], m_targetForce.data[i]);
+    }
+  }
+
+  float time = simGetSimulationTime();
+  long sec = floor(time);
+  long nsec = (time - sec) * 1000*1000*1000;
+  double dt = m_lastTickTime < 0 ? 0.0 : time - m_lastTickTime;
+  size_t sz = m_jointHandle.size();
+  for(uint32_t i = 0;i < sz;i++) {
+    float buf;
+    if (simGetJointPosition(m_jointHandle[i], &buf) < 0) {
+      if (m_jointError.raise(time)) {
+	std::cout << " - onExecute(" << m_objectName << "): GetJointPosition (handle=" << m_jointHandle[i] << ") failed ("
+		  << m_jointError.take() << " times)." << std::endl;
+      }
+      return RTC::RTC_ERROR;
+    }
+    double old_pos = m_currentPosition.data[i];
+    m_currentPosition.data[i] = buf;
+    m_currentVelocity.data[i] = dt > 0 ? (buf - old_pos) / dt : 0.0;
+
+    if (simJointGetForce(m_jointHandle[i], &buf) < 0) {
+      if (m_jointError.raise(time)) {
+	std::cout << " - onExecute(" << m_objectName << "): GetJointForce (handle=" << m_jointHandle[i] << ") failed ("
+		  << m_jointError.take() << " times)." << std::endl;
+      }
+      return RTC::RTC_ERROR;
+    }
+    m_currentForce.data[i] = buf;
+  }
+  m_lastTickTime = time;
+
+  m_allocationCheck.end(time);
+
+  const bool writePosition = m_positionFilter.check(m_currentPosition.data.get_buffer(), m_currentPosition.data.length(), time);
+  const bool writeVelocity = m_velocityFilter.check(m_currentVelocity.data.get_buffer(), m_currentVelocity.data.length(), time);
+  const bool writeForce = m_forceFilter.check(m_currentForce.data.get_buffer(), m_currentForce.data.length(), time);
+
+  // The layout goes with every state write, so late subscribers can split the sequences.
+  if (writePosition || writeVelocity || writeForce) {
+    m_jointCounts.tm.sec = sec;
+    m_jointCounts.tm.nsec = nsec;
+    m_jointCountsOut.write();
+  }
+
+  m_currentPosition.tm.sec = sec;
+  m_currentPosition.tm.nsec = nsec;
+  if (writePosition) {
+    m_currentPositionOut.write();
+  }
+
+  m_currentVelocity.tm.sec = sec;
+  m_currentVelocity.tm.nsec = nsec;
+  if (writeVelocity) {
+    m_currentVelocityOut.write();
+  }
+
+  m_currentForce.tm.sec = sec;
+  m_currentForce.tm.nsec = nsec;
+  if (writeForce) {
+    m_currentForceOut.write();
+  }
+
+  return RTC::RTC_OK;
+}
+
+/*
+RTC::ReturnCode_t RobotFleetRTC::onAborting(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t RobotFleetRTC::onError(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t RobotFleetRTC::onReset(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t RobotFleetRTC::onStateUpdate(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t RobotFleetRTC::onRateChanged(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+
+extern "C"
+{
+ 
+  void RobotFleetRTCInit(RTC::Manager* manager)
+  {
+    coil::Properties profile(robotfleetrtc_spec);
+    manager->registerFactory(profile,
+                             RTC::Create<RobotFleetRTC>,
+                             RTC::Delete<RobotFleetRTC>);
+  }
+  
+};
+
+
@@ -12,6 +12,7 @@
 #include <sstream>
 #include <iostream>
 #include <math.h>
+#include <stdlib.h>
 #include <v_repLib.h>
 // Module specification
 // <rtc-template block="module_spec">
@@ -32,11 +33,24 @@ static const char* robotrtc_spec[] =
     "conf.default.objectName", "none",
     //    "conf.default.objectHandle", "-1",
     "conf.default.activeJointNames", "[]",
+    "conf.default.oversampling", "off",
+    "conf.default.oversamplingBuffer", "100",
+    "conf.default.publishMode", "always",
+    "conf.default.publishDeadband", "0.0",
+    "conf.default.publishKeepAlive", "1.0",
     // Widget
     "conf.__widget__.objectName", "text",
     //"conf.__widget__.objectHandle", "text",
     "conf.__widget__.activeJointNames", "text",
+    "conf.__widget__.oversampling", "radio",
+    "conf.__widget__.oversamplingBuffer", "text",
+    "conf.__widget__.publishMode", "radio",
+    "conf.__widget__.publishDeadband", "text",
+    "conf.__widget__.publishKeepAlive", "text",
     // Constraints
+    "conf.__constraints__.oversampling", "(off,average,batch)",
+    "conf.__constraints__.oversamplingBuffer", "1<=x",
+    "conf.__constraints__.publishMode", "(always,onChange)",
     ""
   };
 // </rtc-template>
@@ -53,7 +67,15 @@ RobotRTC::RobotRTC(RTC::Manager* manager)
     m_targetPositionIn("targetPosition", m_targetPosition),
     m_currentForceOut("currentForce", m_currentForce),
     m_currentVelocityOut("currentVelocity", m_currentVelocity),
-    m_currentPositionOut("currentPosition", m_currentPosition)
+    m_currentPositionOut("currentPosition", m_currentPosition),
+    m_forceSamplesOut("forceSamples", m_forceSamples),
+    m_velocitySamplesOut("velocitySamples", m_velocitySamples),
+    m_positionSamplesOut("positionSamples", m_positionSamples),
+    m_oversamplingMode(OVERSAMPLING_OFF),
+    m_sampleCapacity(1),
+    m_lastSampleValid(false),
+    m_lastTickTime(-1.0),
+    m_allocationCheck("RobotRTC")
 
     // </rtc-template>
 {
@@ -64,10 +86,32 @@ RobotRTC::RobotRTC(RTC::Manager* manager)
  */
 RobotRTC::~RobotRTC()
 {
+  stepListeners.remove(this);
 }
 
 
 
+void splitList(const std::string& str, std::vector<std::string>& tokens)
+{
+  const char* blank = " \t\r\n[]";
+  tokens.clear();
+  std::string::size_type pos = 0;
+  while(true) {
+    std::string::size_type end = str.find(',', pos);
+    std::string::size_type stop = (end == std::string::npos) ? str.size() : end;
+    std::string::size_type first = str.find_first_not_of(blank, pos);
+    if (first != std::string::npos && first < stop) {
+      std::string::size_type last = str.find_last_not_of(blank, stop-1);
+      tokens.push_back(str.substr(first, last - first + 1));
+    }
+    if (end == std::string::npos) {
+      break;
+    }
+    pos = end + 1;
+  }
+}
+
+
 RTC::ReturnCode_t RobotRTC::onInitialize()
 {
   // Registration: InPort/OutPort/Service
@@ -81,6 +125,9 @@ RTC::ReturnCode_t RobotRTC::onInitialize()
   addOutPort("currentForce", m_currentForceOut);
   addOutPort("currentVelocity", m_currentVelocityOut);
   addOutPort("currentPosition", m_currentPositionOut);
+  addOutPort("forceSamples", m_forceSamplesOut);
+  addOutPort("velocitySamples", m_velocitySamplesOut);
+  addOutPort("positionSamples", m_positionSamplesOut);
   
   // Set service provider to Ports
   
@@ -96,42 +143,30 @@ RTC::ReturnCode_t RobotRTC::onInitialize()
   //bindParameter("objectHandle", m_objectHandle, "-1");
   bindParameter("controlledJointNames", m_controlledJointNames, "[]");
   bindParameter("observedJointNames", m_observedJointNames, "[]");
+  bindParameter("oversampling", m_oversampling, "off");
+  bindParameter("oversamplingBuffer", m_oversamplingBuffer, "100");
+  bindParameter("publishMode", m_publishMode, "always");
+  bindParameter("publishDeadband", m_publishDeadband, "0.0");
+  bindParameter("publishKeepAlive", m_publishKeepAlive, "1.0");
   // </rtc-template>
 
 
   std::cout << " - Initializing RobotRTC(" << m_properties.getProperty("conf.default.objectName") << ")" << std::endl;
   std::vector<std::string> keys;
-  std::vector<int32_t> values;
-  
+  std::vector<std::string> values;
+
   std::string names = m_properties.getProperty("conf.__innerparam.allNames");
   std::cout << " -- All Joint Names = " << names << std::endl;
-  std::stringstream nss(names);
-  std::string token;
-  while(std::getline(nss, token, ',')) {
-    std::stringstream trimmer;
-    trimmer << token;
-    token.clear();
-    trimmer >> token;
-    //std::cout << " key = " << token << std::endl;
-    keys.push_back(token);
-  }
+  splitList(names, keys);
 
   std::string handles = m_properties.getProperty("conf.__innerparam.allHandles");
   std::cout << " -- All Joint Handles =" << handles << std::endl;
-  std::stringstream hss(handles);
-  int32_t buf;
-  while(std::getline(hss, token, ',')) {
-    std::stringstream trimmer;
-    trimmer << token;
-    token.clear();
-    trimmer >> buf;
-    //std::cout << " value = " << buf << std::endl;
-    values.push_back(buf);
-  }
+  splitList(handles, values);
 
-  uint32_t size = keys.size();
+  uint32_t size = keys.size() < values.size() ? keys.size() : values.size();
   for(uint32_t i = 0;i < size;i++) {
-    m_jointHandleMap.append(keys[i], values[i]);
+    int32_t handle = atoi(values[i].c_str());
+    m_jointHandleMap.append(keys[i], handle);
   }
 
   std::cout << " -- Initialization Ended." << std::endl;
@@ -164,57 +199,38 @@ RTC::ReturnCode_t RobotRTC::onShutdown(RTC::UniqueId ec_id)
 RTC::ReturnCode_t RobotRTC::onActivated(RTC::UniqueId ec_id)
 {
   std::cout << " - Activating RobotRTC(" << m_objectName << ")" << std::endl;
-  m_controlledJointHandle.clear();
-  m_observedJointHandle.clear();
   updateParameters("default");
 
-  std::string names = m_controlledJointNames;
-  std::cout << " -- config: controlledJointNames=" << names << std::endl;
-  std::stringstream nss(names);
-  std::string token;
-  while(std::getline(nss, token, ',')) {
-    std::stringstream trimmer;
-    trimmer << token;
-    token.clear();
-    trimmer >> token;
-    //std::cout << " key = " << token << std::endl;
-    JointHandleMap::iterator i = m_jointHandleMap.find(token);
-    if (i == m_jointHandleMap.end()) {
-      std::cout << " -- ERROR: Can not find active joint name " << token << std::endl;
-      return RTC::RTC_ERROR;
-    }
-    m_controlledJointHandle.push_back(i->second);
+  std::cout << " -- config: oversampling=" << m_oversampling << std::endl;
+  if (m_oversampling == "average") {
+    m_oversamplingMode = OVERSAMPLING_AVERAGE;
+  } else if (m_oversampling == "batch") {
+    m_oversamplingMode = OVERSAMPLING_BATCH;
+  } else {
+    m_oversamplingMode = OVERSAMPLING_OFF;
+  }
+  if (m_oversamplingMode != OVERSAMPLING_OFF && m_oversamplingBuffer <= 0) {
+    std::cout << " -- Invalid Value of the Configuration: oversamplingBuffer must be positive." << std::endl;
+    return RTC::RTC_ERROR;
   }
-  /*
-  for (int i = 0;i < m_controlledJointHandle.size();i++) {
-    std::cout << " -- config: controlledJointHandle:" << m_controlledJointHandle[i] << std::endl;
-    }*/
-
-  names = m_controlledJointNames;
-  std::cout << " -- config: observedJointNames=" << names << std::endl;
-  std::stringstream nss2(names);
-  //  std::string token;
-  while(std::getline(nss2, token, ',')) {
-    std::stringstream trimmer;
-    trimmer << token;
-    token.clear();
-    trimmer >> token;
-    //std::cout << " key = " << token << std::endl;
-    JointHandleMap::iterator i = m_jointHandleMap.find(token);
-    if (i == m_jointHandleMap.end()) {
-      std::cout << " -- ERROR: Can not find active joint name " << token << std::endl;
+  // Joint reconfiguration between ticks resizes the ring with this copy.
+  m_sampleCapacity = m_oversamplingBuffer > 0 ? m_oversamplingBuffer : 1;
+
+  m_positionFilter.configure(m_publishMode, m_publishDeadband, m_publishKeepAlive);
+  m_velocityFilter.configure(m_publishMode, m_publishDeadband, m_publishKeepAlive);
+  m_forceFilter.configure(m_publishMode, m_publishDeadband, m_publishKeepAlive);
+
+  std::cout << " -- config: controlledJointNames=" << m_controlledJointNames << std::endl;
+  std::cout << " -- config: observedJointNames=" << m_observedJointNames << std::endl;
+  m_rejectedPlan = JointIndexPlan();
+  if (!m_jointPlan.isCompiledFrom(m_controlledJointNames, m_observedJointNames)) {
+    JointIndexPlan plan;
+    if (!compileJointPlan(plan)) {
       return RTC::RTC_ERROR;
     }
-    m_observedJointHandle.push_back(i->second);
+    m_jointPlan = plan;
   }
-  /*
-  for (int i = 0;i < m_observedJointHandle.size();i++) {
-    std::cout << " -- config:observedJointHandle:" << m_observedJointHandle[i] << std::endl;
-    }*/
-
-  m_currentPosition.data.length(m_observedJointHandle.size());
-  m_currentVelocity.data.length(m_observedJointHandle.size());
-  m_currentForce.data.length(m_observedJointHandle.size());
+  setupObservedJoints();
   std::cout << " -- Succeeded." << std::endl;
   return RTC::RTC_OK;
 }
@@ -223,83 +239,285 @@ RTC::ReturnCode_t RobotRTC::onActivated(RTC::UniqueId ec_id)
 RTC::ReturnCode_t RobotRTC::onDeactivated(RTC::UniqueId ec_id)
 {
   std::cout << " - Deactivated RobotRTC(" << m_objectName << ")" << std::endl;
+  stepListeners.remove(this);
+  if (m_sampleRing.overflow() > 0) {
+    std::cout << " -- " << m_sampleRing.overflow() << " samples overwritten. Increase oversamplingBuffer." << std::endl;
+  }
+  m_sampleRing.clear();
+  if (m_sizeError.total() + m_jointError.total() > 0) {
+    std::cout << " -- " << m_sizeError.total() << " invalid data size errors, "
+	      << m_jointError.total() << " joint access errors." << std::endl;
+  }
+  m_sizeError.reset();
+  m_jointError.reset();
+  m_allocationCheck.reset();
+  return RTC::RTC_OK;
+}
+
+
+bool RobotRTC::resolveJointNames(const std::string& names, JointHandleList& handles)
+{
+  std::vector<std::string> tokens;
+  splitList(names, tokens);
+  handles.clear();
+  handles.reserve(tokens.size());
+  for(uint32_t i = 0;i < tokens.size();i++) {
+    JointHandleMap::iterator it = m_jointHandleMap.find(tokens[i]);
+    if (it == m_jointHandleMap.end()) {
+      std::cout << " -- ERROR: Can not find active joint name " << tokens[i] << std::endl;
+      return false;
+    }
+    handles.push_back(it->second);
+  }
+  return true;
+}
+
+
+bool RobotRTC::compileJointPlan(JointIndexPlan& plan)
+{
+  plan.controlledSource = m_controlledJointNames;
+  plan.observedSource = m_observedJointNames;
+  plan.parsed = true;
+  return resolveJointNames(plan.controlledSource, plan.controlled) &&
+    resolveJointNames(plan.observedSource, plan.observed);
+}
+
+
+void RobotRTC::setupObservedJoints()
+{
+  size_t sz = m_jointPlan.observed.size();
+  m_currentPosition.data.length(sz);
+  m_currentVelocity.data.length(sz);
+  m_currentForce.data.length(sz);
+  m_lastTickTime = -1.0;
+
+  stepListeners.remove(this);
+  if (m_oversamplingMode != OVERSAMPLING_OFF && sz > 0) {
+    m_sampleRing.resize(sz, m_sampleCapacity);
+    m_lastSamplePosition.assign(sz, 0.0f);
+    m_lastSampleValid = false;
+    stepListeners.add(this);
+  } else {
+    m_sampleRing.resize(0, 1);
+  }
+}
+
+
+void RobotRTC::reconfigureJoints()
+{
+  std::cout << " - RobotRTC(" << m_objectName << "): joint configuration changed." << std::endl;
+  JointIndexPlan plan;
+  if (!compileJointPlan(plan)) {
+    std::cout << " -- Keeping the current joint set." << std::endl;
+    m_rejectedPlan = plan;
+    return;
+  }
+  bool observedChanged = plan.observed != m_jointPlan.observed;
+  m_jointPlan = plan;
+  if (observedChanged) {
+    setupObservedJoints();
+  }
+}
+
+
+void RobotRTC::onSimulationStep(const float time, const float timeStep)
+{
+  size_t sz = m_jointPlan.observed.size();
+  double* row = m_sampleRing.next(time);
+  double* pos = row;
+  double* vel = row + sz;
+  double* force = row + sz*2;
+  for(uint32_t i = 0;i < sz;i++) {
+    float buf;
+    if (simGetJointPosition(m_jointPlan.observed[i], &buf) < 0) {
+      buf = m_lastSamplePosition[i];
+    }
+    pos[i] = buf;
+    vel[i] = (m_lastSampleValid && timeStep > 0) ? (buf - m_lastSamplePosition[i]) / timeStep : 0.0;
+    m_lastSamplePosition[i] = buf;
+
+    if (simJointGetForce(m_jointPlan.observed[i], &buf) < 0) {
+      buf = 0;
+    }
+    force[i] = buf;
+  }
+  m_lastSampleValid = true;
+}
+
+
+bool RobotRTC::checkLength(const RTC::TimedDoubleSeq& data)
+{
+  if (m_jointPlan.controlled.size() != data.data.length()) {
+    if (m_sizeError.raise(simGetSimulationTime())) {
+      std::cout << " - onExecute(" << m_objectName << "): Invalid Data number. This RTC reuqires " << m_jointPlan.controlled.size() << " data size."
+		<< " But " << data.data.length() << " data is sent (" << m_sizeError.take() << " times)." << std::endl;
+    }
+    return false;
+  }
+  return true;
+}
+
+
+RTC::ReturnCode_t RobotRTC::readObservedJoints(const double time)
+{
+  // Velocity is the difference between ticks, so divide by the tick interval.
+  double dt = m_lastTickTime < 0 ? 0.0 : time - m_lastTickTime;
+  size_t sz = m_jointPlan.observed.size();
+  for(uint32_t i = 0;i < sz;i++) {
+    float buf;
+    if (simGetJointPosition(m_jointPlan.observed[i], &buf) < 0) {
+      if (m_jointError.raise(time)) {
+	std::cout << " - onExecute(" << m_objectName << "): GetJointPosition (handle=" << m_jointPlan.observed[i] << ") failed ("
+		  << m_jointError.take() << " times)." << std::endl;
+      }
+      return RTC::RTC_ERROR;
+    }
+    double old_pos = m_currentPosition.data[i];
+    m_currentPosition.data[i] = buf;
+    m_currentVelocity.data[i] = dt > 0 ? (buf - old_pos) / dt : 0.0;
+
+    if (simJointGetForce(m_jointPlan.observed[i], &buf) < 0) {
+      if (m_jointError.raise(time)) {
+	std::cout << " - onExecute(" << m_objectName << "): GetJointForce (handle=" << m_jointPlan.observed[i] << ") failed ("
+		  << m_jointError.take() << " times)." << std::endl;
+      }
+      return RTC::RTC_ERROR;
+    }
+    m_currentForce.data[i] = buf;
+  }
+  m_lastTickTime = time;
   return RTC::RTC_OK;
 }
 
 
+void RobotRTC::publishSamples()
+{
+  uint32_t n = m_sampleRing.size();
+  uint32_t sz = m_sampleRing.jointCount();
+  if (m_oversamplingMode == OVERSAMPLING_AVERAGE) {
+    // Position and velocity are averaged. Force keeps the peak so that spikes survive.
+    for(uint32_t j = 0;j < sz;j++) {
+      double pos = 0, vel = 0, force = 0;
+      for(uint32_t i = 0;i < n;i++) {
+	const double* row = m_sampleRing.at(i);
+	pos += row[j];
+	vel += row[sz + j];
+	if (fabs(row[sz*2 + j]) > fabs(force)) {
+	  force = row[sz*2 + j];
+	}
+      }
+      m_currentPosition.data[j] = pos / n;
+      m_currentVelocity.data[j] = vel / n;
+      m_currentForce.data[j] = force;
+    }
+  } else {
+    const double* latest = m_sampleRing.latest();
+    m_positionSamples.data.length(n * sz);
+    m_velocitySamples.data.length(n * sz);
+    m_forceSamples.data.length(n * sz);
+    for(uint32_t i = 0;i < n;i++) {
+      const double* row = m_sampleRing.at(i);
+      for(uint32_t j = 0;j < sz;j++) {
+	m_positionSamples.data[i*sz + j] = row[j];
+	m_velocitySamples.data[i*sz + j] = row[sz + j];
+	m_forceSamples.data[i*sz + j] = row[sz*2 + j];
+      }
+    }
+    for(uint32_t j = 0;j < sz;j++) {
+      m_currentPosition.data[j] = latest[j];
+      m_currentVelocity.data[j] = latest[sz + j];
+      m_currentForce.data[j] = latest[sz*2 + j];
+    }
+  }
+  m_lastTickTime = m_sampleRing.latestTime();
+  m_sampleRing.clear();
+}
+
+
 RTC::ReturnCode_t RobotRTC::onExecute(RTC::UniqueId ec_id)
 {
+  // Configuration is updated between ticks, so the new plan applies to this whole tick.
+  if (!m_jointPlan.isCompiledFrom(m_controlledJointNames, m_observedJointNames) &&
+      !m_rejectedPlan.isCompiledFrom(m_controlledJointNames, m_observedJointNames)) {
+    reconfigureJoints();
+  }
+  m_allocationCheck.begin();
+
   if (m_targetPositionIn.isNew()) {
     m_targetPositionIn.read();
-    if (m_controlledJointHandle.size() != m_targetPosition.data.length()) {
-      std::cout << " - onExecute(" << m_objectName << "): Invalid Data number. This RTC reuqires " << m_controlledJointHandle.size() << " data size." << std::ends;
-      std::cout << " -- But " << m_targetPosition.data.length() << " data is sent." << std::endl;
+    if (!checkLength(m_targetPosition)) {
       return RTC::RTC_ERROR;
     }
     for(uint32_t i = 0;i < m_targetPosition.data.length();i++) {
-      simSetJointTargetPosition(m_controlledJointHandle[i], m_targetPosition.data[i]);
+      simSetJointTargetPosition(m_jointPlan.controlled[i], m_targetPosition.data[i]);
     }
   }
 
   if (m_targetVelocityIn.isNew()) {
     m_targetVelocityIn.read();
-    if (m_controlledJointHandle.size() != m_targetVelocity.data.length()) {
-      std::cout << " - onExecute(" << m_objectName << "): Invalid Data number. This RTC reuqires " << m_controlledJointHandle.size() << " data size." << std::ends;
-      std::cout << " -- But " << m_targetVelocity.data.length() << " data is sent." << std::endl;
+    if (!checkLength(m_targetVelocity)) {
       return RTC::RTC_ERROR;
     }
     for(uint32_t i = 0;i < m_targetVelocity.data.length();i++) {
-      simSetJointTargetVelocity(m_controlledJointHandle[i], m_targetVelocity.data[i]);
+      simSetJointTargetVelocity(m_jointPlan.controlled[i], m_targetVelocity.data[i]);
     }
   }
 
   if (m_targetForceIn.isNew()) {
     m_targetForceIn.read();
-    if (m_controlledJointHandle.size() != m_targetForce.data.length()) {
-      std::cout << " - onExecute(" << m_objectName << "): Invalid Data number. This RTC reuqires " << m_controlledJointHandle.size() << " data size." << std::ends;
-      std::cout << " -- But " << m_targetForce.data.length() << " data is sent." << std::endl;
+    if (!checkLength(m_targetForce)) {
       return RTC::RTC_ERROR;
     }
     for(uint32_t i = 0;i < m_targetForce.data.length();i++) {
-      simSetJointForce(m_controlledJointHandle[i], m_targetForce.data[i]);
+      simSetJointForce(m_jointPlan.controlled[i], m_targetForce.data[i]);
     }
   }
   
-  float dt = simGetSimulationTimeStep();
   float time = simGetSimulationTime();
   long sec = floor(time);
   long nsec = (time - sec) * 1000*1000*1000;
-  size_t sz = m_observedJointHandle.size();
-  for(uint32_t i = 0;i < sz;i++) {
-    float buf;
-    if (simGetJointPosition(m_observedJointHandle[i], &buf) < 0) {
-      std::cout << " - onExecute(" << m_objectName << "): GetJointPosition (handle=" << m_observedJointHandle[i] << ") failed." << std::endl;
-      return RTC::RTC_ERROR;
-    }
-    double old_pos = m_currentPosition.data[i];
-    m_currentPosition.data[i] = buf;
-    double v = (buf - old_pos) / dt;
-    
-    m_currentVelocity.data[i] = v;
-
-    if (simJointGetForce(m_observedJointHandle[i], &buf) < 0) {
-      std::cout << " - onExecute(" << m_objectName << "): GetJointForce (handle=" << m_observedJointHandle[i] << ") failed." << std::endl;
+  bool batch = false;
+  if (m_oversamplingMode == OVERSAMPLING_OFF || m_sampleRing.empty()) {
+    if (readObservedJoints(time) != RTC::RTC_OK) {
       return RTC::RTC_ERROR;
     }
-    m_currentForce.data[i] = buf;
-
+  } else {
+    batch = m_oversamplingMode == OVERSAMPLING_BATCH;
+    publishSamples();
   }
+  m_allocationCheck.end(time);
+
   m_currentPosition.tm.sec = sec;
   m_currentPosition.tm.nsec = nsec;
-  m_currentPositionOut.write();
+  if (m_positionFilter.check(m_currentPosition.data.get_buffer(), m_currentPosition.data.length(), time)) {
+    m_currentPositionOut.write();
+  }
 
   m_currentVelocity.tm.sec = sec;
   m_currentVelocity.tm.nsec = nsec;
-  m_currentVelocityOut.write();
+  if (m_velocityFilter.check(m_currentVelocity.data.get_buffer(), m_currentVelocity.data.length(), time)) {
+    m_currentVelocityOut.write();
+  }
 
   m_currentForce.tm.sec = sec;
   m_currentForce.tm.nsec = nsec;
-  m_currentForceOut.write();
+  if (m_forceFilter.check(m_currentForce.data.get_buffer(), m_currentForce.data.length(), time)) {
+    m_currentForceOut.write();
+  }
+
+  if (batch) {
+    m_positionSamples.tm.sec = sec;
+    m_positionSamples.tm.nsec = nsec;
+    m_positionSamplesOut.write();
+
+    m_velocitySamples.tm.sec = sec;
+    m_velocitySamples.tm.nsec = nsec;
+    m_velocitySamplesOut.write();
+
+    m_forceSamples.tm.sec = sec;
+    m_forceSamples.tm.nsec = nsec;
+    m_forceSamplesOut.write();
+  }
 
   return RTC::RTC_OK;
 }
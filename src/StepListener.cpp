@@ -0,0 +1,3 @@
+#include "StepListener.h"
+
+StepListenerList stepListeners;
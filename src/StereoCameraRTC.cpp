@@ -0,0 +1,363 @@
+// -*- C++ -*-
+/*!
+ * @file  StereoCameraRTC.cpp
+ * @brief Simulator Stereo Camera RTC for VREP simulator
+ *
+ * Both vision sensors are rendered and fetched on the same step and the
+ * left and right images are written with the same timestamp. The images
+ * are converted (and rectified) in parallel.
+ */
+
+#include "StereoCameraRTC.h"
+#include "VisionSensorManager.h"
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <v_repLib.h>
+// Module specification
+// <rtc-template block="module_spec">
+static const char* stereocamerartc_spec[] =
+  {
+    "implementation_id", "StereoCameraRTC",
+    "type_name",         "StereoCameraRTC",
+    "description",       "Simulator Stereo Camera RTC",
+    "version",           "1.0.0",
+    "vendor",            "ysuga_net",
+    "category",          "Simulator",
+    "activity_type",     "PERIODIC",
+    "kind",              "DataFlowComponent",
+    "max_instance",      "1",
+    "language",          "C++",
+    "lang_type",         "compile",
+    // Configuration variables
+    "conf.default.objectName", "none",
+    "conf.default.rectify", "on",
+    "conf.default.imageSource", "float",
+    "conf.default.renderMode", "always",
+    "conf.default.workerThreads", "1",
+    "conf.default.decimation", "1",
+    // Widget
+    "conf.__widget__.objectName", "text",
+    "conf.__widget__.rectify", "radio",
+    "conf.__widget__.imageSource", "radio",
+    "conf.__widget__.renderMode", "radio",
+    "conf.__widget__.workerThreads", "text",
+    "conf.__widget__.decimation", "text",
+    // Constraints
+    "conf.__constraints__.rectify", "(on,off)",
+    "conf.__constraints__.imageSource", "(float,byte)",
+    "conf.__constraints__.renderMode", "(always,onDemand)",
+    "conf.__constraints__.workerThreads", "0<=x<=1",
+    "conf.__constraints__.decimation", "1<=x",
+    ""
+  };
+// </rtc-template>
+
+/*!
+ * @brief constructor
+ * @param manager Maneger Object
+ */
+StereoCameraRTC::StereoCameraRTC(RTC::Manager* manager)
+    // <rtc-template block="initializer">
+  : RTC::DataFlowComponentBase(manager),
+    m_leftOut("left", m_left),
+    m_rightOut("right", m_right),
+    // </rtc-template>
+    m_allocationCheck("StereoCameraRTC")
+{
+}
+
+/*!
+ * @brief destructor
+ */
+StereoCameraRTC::~StereoCameraRTC()
+{
+}
+
+
+
+RTC::ReturnCode_t StereoCameraRTC::onInitialize()
+{
+  // Registration: InPort/OutPort/Service
+  // <rtc-template block="registration">
+  // Set InPort buffers
+
+  // Set OutPort buffer
+  addOutPort("left", m_leftOut);
+  addOutPort("right", m_rightOut);
+
+  // Set service provider to Ports
+  
+  // Set service consumers to Ports
+  
+  // Set CORBA Service Ports
+  
+  // </rtc-template>
+
+  // <rtc-template block="bind_config">
+  // Bind variables and configuration variable
+  bindParameter("objectName", m_objectName, "none");
+  bindParameter("rectify", m_rectify, "on");
+  bindParameter("imageSource", m_imageSource, "float");
+  bindParameter("renderMode", m_renderMode, "always");
+  bindParameter("workerThreads", m_workerThreads, "1");
+  bindParameter("decimation", m_decimation, "1");
+  // </rtc-template>
+
+  std::cout << " - Initializing StereoCameraRTC(" << m_properties.getProperty("conf.default.objectName") << ")" << std::endl;
+
+  std::istringstream names(m_properties.getProperty("conf.__innerparam.objectNames"));
+  std::string token;
+  while(std::getline(names, token, ',')) {
+    m_objectNames.push_back(token);
+  }
+  std::istringstream handles(m_properties.getProperty("conf.__innerparam.objectHandles"));
+  while(std::getline(handles, token, ',')) {
+    m_objectHandles.push_back(atoi(token.c_str()));
+  }
+  return RTC::RTC_OK;
+}
+
+ 
+RTC::ReturnCode_t StereoCameraRTC::onFinalize()
+{
+  return RTC::RTC_OK;
+}
+
+
+/*
+RTC::ReturnCode_t StereoCameraRTC::onStartup(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t StereoCameraRTC::onShutdown(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+RTC::ReturnCode_t StereoCameraRTC::onActivated(RTC::UniqueId ec_id)
+{
+  std::cout << " - Activating StereoCameraRTC: " << m_objectName << std::endl;
+  if (m_objectHandles.size() != 2 || m_objectNames.size() != 2) {
+    std::cout << " -- Needs a left and a right camera." << std::endl;
+    return RTC::RTC_ERROR;
+  }
+  float angle[2];
+  for(int i = 0;i < 2;i++) {
+    simInt resolution[2]; // x, y
+    if (simGetVisionSensorResolution(m_objectHandles[i], resolution) < 0 ||
+	simGetObjectFloatParameter(m_objectHandles[i], sim_visionfloatparam_perspective_angle, &angle[i]) <= 0) {
+      std::cout << " -- Sensor Parameter Request Failed (" << m_objectNames[i] << ")." << std::endl;
+      return RTC::RTC_ERROR;
+    }
+    if (i == 0) {
+      m_sensorWidth = resolution[0];
+      m_sensorHeight = resolution[1];
+    } else if (resolution[0] != m_sensorWidth || resolution[1] != m_sensorHeight || fabs(angle[1] - angle[0]) > 1e-6) {
+      std::cout << " -- Left and right cameras have different resolutions or view angles." << std::endl;
+      return RTC::RTC_ERROR;
+    }
+  }
+  m_tickPeriod = m_decimation > 1 ? m_decimation : 1;
+
+  // Rectification needs the relative pose, which is fixed while the rig is rigid.
+  float matrix[2][12];
+  float rectified[12];
+  bool rectify = (m_rectify == "on");
+  if (rectify) {
+    if (simGetObjectMatrix(m_objectHandles[0], -1, matrix[0]) < 0 ||
+	simGetObjectMatrix(m_objectHandles[1], -1, matrix[1]) < 0) {
+      std::cout << " -- Object Matrix Request Failed." << std::endl;
+      return RTC::RTC_ERROR;
+    }
+    if (!stereoRectifiedRotation(matrix[0], matrix[1], rectified)) {
+      std::cout << " -- " << m_objectNames[1] << " is not on the right of " << m_objectNames[0] << "." << std::endl;
+      return RTC::RTC_ERROR;
+    }
+  }
+  float focalLength = visionSensorFocalLength(m_sensorWidth, m_sensorHeight, angle[0]);
+  ImageRegion region = {0, 0, 0, 0};
+  RTC::CameraImage* images[2] = {&m_left, &m_right};
+  for(int i = 0;i < 2;i++) {
+    m_conversion.converters[i].configure(m_sensorWidth, m_sensorHeight, region, 1);
+    if (rectify) {
+      m_conversion.maps[i].configure(m_sensorWidth, m_sensorHeight, focalLength, matrix[i], rectified);
+    } else {
+      m_conversion.maps[i] = RectificationMap();
+    }
+    m_conversion.scratch[i].resize(m_conversion.maps[i].identity() ? 0 : m_sensorWidth * m_sensorHeight * 3);
+    m_conversion.images[i] = NULL;
+    m_conversion.charImages[i] = NULL;
+    images[i]->width = m_sensorWidth;
+    images[i]->height = m_sensorHeight;
+    images[i]->bpp = 24;
+    images[i]->format = "bitmap";
+    images[i]->fDiv = 1.0;
+    images[i]->pixels.length(m_sensorWidth * m_sensorHeight * 3);
+    m_conversion.dst[i] = images[i]->pixels.get_buffer();
+  }
+
+  std::cout << " -- Cameras = " << m_objectNames[0] << ", " << m_objectNames[1] << std::endl;
+  std::cout << " -- Camera Resolution = " << m_sensorWidth << "x" << m_sensorHeight << std::endl;
+  std::cout << " -- Rectification = " << m_rectify;
+  if (rectify) {
+    std::cout << " (left " << (m_conversion.maps[0].identity() ? "unchanged" : "remapped")
+	      << ", right " << (m_conversion.maps[1].identity() ? "unchanged" : "remapped") << ")";
+  }
+  std::cout << std::endl;
+  std::cout << " -- Image Source = " << m_imageSource << std::endl;
+
+  m_renderOnDemand.assign(2, false);
+  for(int i = 0;i < 2;i++) {
+    m_renderOnDemand[i] = visionSensors.acquire(m_objectHandles[i], m_renderMode == "onDemand");
+    if (m_renderMode == "onDemand" && !m_renderOnDemand[i]) {
+      std::cout << " -- Explicit handling of " << m_objectNames[i] << " failed, rendered on every step." << std::endl;
+    }
+  }
+  requestRenderings();
+  m_workerPool.start(m_workerThreads > 0 ? 1 : 0);
+  m_tick = 0;
+  return RTC::RTC_OK;
+}
+
+
+RTC::ReturnCode_t StereoCameraRTC::onDeactivated(RTC::UniqueId ec_id)
+{
+  m_workerPool.stop();
+  if (m_imageError.total() > 0) {
+    std::cout << " - Deactivated StereoCameraRTC: " << m_imageError.total() << " ticks without image pair." << std::endl;
+  }
+  for(size_t i = 0;i < m_renderOnDemand.size();i++) {
+    visionSensors.release(m_objectHandles[i], m_renderOnDemand[i]);
+  }
+  m_renderOnDemand.clear();
+  m_imageError.reset();
+  m_allocationCheck.reset();
+  return RTC::RTC_OK;
+}
+
+/*!
+ * Ask for the renderings of the next tick, done on the V-REP main thread.
+ */
+void StereoCameraRTC::requestRenderings()
+{
+  for(size_t i = 0;i < m_renderOnDemand.size();i++) {
+    if (m_renderOnDemand[i]) {
+      visionSensors.request(m_objectHandles[i]);
+    }
+  }
+}
+
+/*!
+ * Fetch both cameras at the same simulation time, convert them in
+ * parallel and write the pair only if both images are available.
+ */
+RTC::ReturnCode_t StereoCameraRTC::onExecute(RTC::UniqueId ec_id)
+{
+  const bool publish = (m_tick++ % m_tickPeriod == 0);
+  if (m_tick % m_tickPeriod == 0) {
+    requestRenderings();
+  }
+  if (!publish) {
+    return RTC::RTC_OK;
+  }
+  m_allocationCheck.begin();
+  float time = simGetSimulationTime();
+  // Chosen once per tick, the pointers of the other source may be released already.
+  m_conversion.byteSource = (m_imageSource == "byte");
+  for(int i = 0;i < 2;i++) {
+    if (m_renderOnDemand[i] && !visionSensors.rendered(m_objectHandles[i])) {
+      if (m_imageError.raise(time)) {
+	std::cout << " -- ERROR, StereoCameraRTC::Rendering " << m_objectNames[i] << " failed (" << m_imageError.take() << " times)" << std::endl;
+      }
+      return RTC::RTC_OK;
+    }
+    bool ok;
+    if (m_conversion.byteSource) {
+      int resolution[2];
+      m_conversion.images[i] = NULL;
+      m_conversion.charImages[i] = visionSensors.charImage(m_objectHandles[i], time, resolution);
+      ok = m_conversion.charImages[i] != NULL && resolution[0] == m_sensorWidth && resolution[1] == m_sensorHeight;
+    } else {
+      m_conversion.charImages[i] = NULL;
+      m_conversion.images[i] = visionSensors.image(m_objectHandles[i], time);
+      ok = m_conversion.images[i] != NULL;
+    }
+    if (!ok) {
+      if (m_imageError.raise(time)) {
+	std::cout << " -- ERROR, StereoCameraRTC::No image of " << m_objectNames[i] << " (" << m_imageError.take() << " times)" << std::endl;
+      }
+      return RTC::RTC_OK;
+    }
+  }
+
+  m_workerPool.run(m_conversion, 2);
+
+  long sec = floor(time);
+  long nsec = (time - sec) * 1000*1000*1000;
+  m_left.tm.sec = m_right.tm.sec = sec;
+  m_left.tm.nsec = m_right.tm.nsec = nsec;
+  m_allocationCheck.end(time);
+  m_leftOut.write();
+  m_rightOut.write();
+  return RTC::RTC_OK;
+}
+
+/*
+RTC::ReturnCode_t StereoCameraRTC::onAborting(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t StereoCameraRTC::onError(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t StereoCameraRTC::onReset(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t StereoCameraRTC::onStateUpdate(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t StereoCameraRTC::onRateChanged(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+
+extern "C"
+{
+ 
+  void StereoCameraRTCInit(RTC::Manager* manager)
+  {
+    coil::Properties profile(stereocamerartc_spec);
+    manager->registerFactory(profile,
+                             RTC::Create<StereoCameraRTC>,
+                             RTC::Delete<StereoCameraRTC>);
+  }
+  
+};
+
+
@@ -0,0 +1,137 @@
+#include "StereoRectification.h"
+#include <string.h>
+#include <math.h>
+
+float visionSensorFocalLength(const int width, const int height, const float perspectiveAngle) {
+  const int size = width > height ? width : height;
+  return (size / 2.0f) / tanf(perspectiveAngle / 2.0f);
+}
+
+// Axis k (0:x, 1:y, 2:z) of a simGetObjectMatrix matrix.
+static void axis(const float* m, const int k, float* v) {
+  v[0] = m[k];
+  v[1] = m[4 + k];
+  v[2] = m[8 + k];
+}
+
+static void setAxis(float* m, const int k, const float* v) {
+  m[k] = v[0];
+  m[4 + k] = v[1];
+  m[8 + k] = v[2];
+}
+
+static float dot(const float* a, const float* b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross(const float* a, const float* b, float* c) {
+  c[0] = a[1] * b[2] - a[2] * b[1];
+  c[1] = a[2] * b[0] - a[0] * b[2];
+  c[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static bool normalize(float* v) {
+  float n = sqrtf(dot(v, v));
+  if (n < 1e-9f) {
+    return false;
+  }
+  v[0] /= n;
+  v[1] /= n;
+  v[2] /= n;
+  return true;
+}
+
+bool stereoRectifiedRotation(const float* left, const float* right, float* rotation) {
+  float baseline[3] = {right[3] - left[3], right[7] - left[7], right[11] - left[11]};
+  if (!normalize(baseline)) {
+    return false;
+  }
+  float leftX[3];
+  axis(left, 0, leftX);
+  if (dot(baseline, leftX) >= 0) { // image right is -x
+    return false;
+  }
+  float leftZ[3], rightZ[3];
+  axis(left, 2, leftZ);
+  axis(right, 2, rightZ);
+  float view[3] = {leftZ[0] + rightZ[0], leftZ[1] + rightZ[1], leftZ[2] + rightZ[2]};
+  float d = dot(view, baseline);
+  for(int i = 0;i < 3;i++) {
+    view[i] -= d * baseline[i];
+  }
+  if (!normalize(view)) {
+    return false;
+  }
+  float x[3] = {-baseline[0], -baseline[1], -baseline[2]};
+  float y[3];
+  cross(baseline, view, y);
+  setAxis(rotation, 0, x);
+  setAxis(rotation, 1, y);
+  setAxis(rotation, 2, view);
+  return true;
+}
+
+void RectificationMap::configure(const int width, const int height, const float focalLength,
+				 const float* sensor, const float* rectified)
+{
+  m_width = width;
+  m_height = height;
+  m_map.resize(width * height);
+  float rx[3], ry[3], rz[3], sx[3], sy[3], sz[3];
+  axis(rectified, 0, rx);
+  axis(rectified, 1, ry);
+  axis(rectified, 2, rz);
+  axis(sensor, 0, sx);
+  axis(sensor, 1, sy);
+  axis(sensor, 2, sz);
+  const float cx = width / 2.0f - 0.5f;
+  const float cy = height / 2.0f - 0.5f;
+  m_identity = true;
+  for(int v = 0;v < height;v++) {
+    for(int u = 0;u < width;u++) {
+      // Ray of the rectified pixel in the world frame, then in the sensor frame.
+      float dx = -(u - cx) / focalLength;
+      float dy = -(v - cy) / focalLength;
+      float ray[3];
+      for(int i = 0;i < 3;i++) {
+	ray[i] = rx[i] * dx + ry[i] * dy + rz[i];
+      }
+      float z = dot(ray, sz);
+      int32_t index = -1;
+      if (z > 1e-6f) {
+	int su = (int)floorf(-dot(ray, sx) / z * focalLength + cx + 0.5f);
+	int sv = (int)floorf(-dot(ray, sy) / z * focalLength + cy + 0.5f);
+	if (su >= 0 && su < width && sv >= 0 && sv < height) {
+	  index = (sv * width + su) * 3;
+	}
+      }
+      m_map[v * width + u] = index;
+      if (index != (v * width + u) * 3) {
+	m_identity = false;
+      }
+    }
+  }
+  if (m_identity) {
+    m_map.clear();
+  }
+}
+
+void RectificationMap::remap(const uint8_t* src, uint8_t* dst) const
+{
+  if (m_identity) {
+    memcpy(dst, src, m_width * m_height * 3);
+    return;
+  }
+  const int32_t* map = &m_map[0];
+  for(int i = 0;i < m_width * m_height;i++) {
+    int32_t index = map[i];
+    if (index < 0) {
+      dst[0] = dst[1] = dst[2] = 0;
+    } else {
+      dst[0] = src[index];
+      dst[1] = src[index + 1];
+      dst[2] = src[index + 2];
+    }
+    dst += 3;
+  }
+}
@@ -0,0 +1,195 @@
+#include "VisionSensorManager.h"
+
+VisionSensorManager visionSensors;
+
+bool VisionSensorManager::acquire(const int handle, const bool onDemand) {
+  MutexBinder b(m_m);
+  std::map<int, Sensor>::iterator it = m_sensors.find(handle);
+  if (it == m_sensors.end()) {
+    simInt flags = simGetExplicitHandling(handle);
+    if (flags < 0) {
+      return false;
+    }
+    Sensor s;
+    s.users = 0;
+    s.alwaysUsers = 0;
+    s.savedFlags = flags;
+    s.explicitHandling = false;
+    s.requested = false;
+    s.failed = false;
+    s.renders = 0;
+    s.firstRender = -1;
+    s.lastRender = -1;
+    it = m_sensors.insert(std::make_pair(handle, s)).first;
+  }
+  Sensor& s = it->second;
+  if (onDemand) {
+    s.users++;
+    if (updateHandling(handle, s)) {
+      return true;
+    }
+    s.users--;
+  }
+  s.alwaysUsers++;
+  updateHandling(handle, s);
+  return false;
+}
+
+void VisionSensorManager::release(const int handle, const bool onDemand) {
+  MutexBinder b(m_m);
+  std::map<int, Sensor>::iterator it = m_sensors.find(handle);
+  if (it == m_sensors.end()) {
+    return;
+  }
+  Sensor& s = it->second;
+  if (onDemand) {
+    s.users--;
+  } else {
+    s.alwaysUsers--;
+  }
+  if (s.users > 0 || s.alwaysUsers > 0) {
+    updateHandling(handle, s);
+    return;
+  }
+  if (s.explicitHandling) {
+    simSetExplicitHandling(handle, s.savedFlags);
+  }
+  m_sensors.erase(it);
+}
+
+bool VisionSensorManager::updateHandling(const int handle, Sensor& s) {
+  const bool explicitHandling = (s.users > 0 && s.alwaysUsers == 0);
+  if (explicitHandling == s.explicitHandling) {
+    return true;
+  }
+  if (simSetExplicitHandling(handle, explicitHandling ? (s.savedFlags | 1) : s.savedFlags) < 0) {
+    return false;
+  }
+  s.explicitHandling = explicitHandling;
+  s.requested = false;
+  s.failed = false;
+  return true;
+}
+
+void VisionSensorManager::request(const int handle) {
+  MutexBinder b(m_m);
+  std::map<int, Sensor>::iterator it = m_sensors.find(handle);
+  if (it != m_sensors.end() && it->second.explicitHandling) {
+    it->second.requested = true;
+  }
+}
+
+void VisionSensorManager::renderRequested(const float time) {
+  MutexBinder b(m_m);
+  for(std::map<int, Sensor>::iterator it = m_sensors.begin();it != m_sensors.end();++it) {
+    Sensor& s = it->second;
+    // A request made after this time's rendering is for the next step.
+    if (!s.requested || (s.renders > 0 && s.lastRender == time)) {
+      continue;
+    }
+    s.requested = false;
+    s.failed = (simHandleVisionSensor(it->first, NULL, NULL) < 0);
+    if (s.failed) {
+      continue;
+    }
+    invalidate(it->first);
+    if (s.renders == 0) {
+      s.firstRender = time;
+    }
+    s.renders++;
+    s.lastRender = time;
+  }
+}
+
+bool VisionSensorManager::rendered(const int handle) {
+  MutexBinder b(m_m);
+  std::map<int, Sensor>::iterator it = m_sensors.find(handle);
+  return it == m_sensors.end() || !it->second.failed;
+}
+
+uint32_t VisionSensorManager::renderCount(const int handle) {
+  MutexBinder b(m_m);
+  std::map<int, Sensor>::iterator it = m_sensors.find(handle);
+  return it == m_sensors.end() ? 0 : it->second.renders;
+}
+
+float VisionSensorManager::renderRate(const int handle) {
+  MutexBinder b(m_m);
+  std::map<int, Sensor>::iterator it = m_sensors.find(handle);
+  if (it == m_sensors.end() || it->second.renders < 2 || it->second.lastRender <= it->second.firstRender) {
+    return 0;
+  }
+  const Sensor& s = it->second;
+  return (s.renders - 1) / (s.lastRender - s.firstRender);
+}
+
+void VisionSensorManager::invalidate(const int handle) {
+  std::map<int, Cache>::iterator it = m_caches.find(handle);
+  if (it == m_caches.end()) {
+    return;
+  }
+  Cache& c = it->second;
+  c.image.release();
+  c.charImage.release();
+  c.depth.release();
+}
+
+const float* VisionSensorManager::image(const int handle, const float time) {
+  MutexBinder b(m_m);
+  Buffer<simFloat>& buf = m_caches[handle].image;
+  if (buf.data != NULL && buf.time == time) {
+    m_hits++;
+    return buf.data;
+  }
+  if (buf.data != NULL) {
+    simReleaseBuffer((simChar*)buf.data);
+  }
+  m_fetches++;
+  buf.data = simGetVisionSensorImage(handle);
+  buf.time = time;
+  return buf.data;
+}
+
+const uint8_t* VisionSensorManager::charImage(const int handle, const float time, int* resolution) {
+  MutexBinder b(m_m);
+  Buffer<simUChar>& buf = m_caches[handle].charImage;
+  if (buf.data == NULL || buf.time != time) {
+    if (buf.data != NULL) {
+      simReleaseBuffer((simChar*)buf.data);
+    }
+    m_fetches++;
+    buf.data = simGetVisionSensorCharImage(handle, &buf.resolution[0], &buf.resolution[1]);
+    buf.time = time;
+  } else {
+    m_hits++;
+  }
+  resolution[0] = buf.resolution[0];
+  resolution[1] = buf.resolution[1];
+  return buf.data;
+}
+
+const float* VisionSensorManager::depthBuffer(const int handle, const float time) {
+  MutexBinder b(m_m);
+  Buffer<simFloat>& buf = m_caches[handle].depth;
+  if (buf.data != NULL && buf.time == time) {
+    m_hits++;
+    return buf.data;
+  }
+  if (buf.data != NULL) {
+    simReleaseBuffer((simChar*)buf.data);
+  }
+  m_fetches++;
+  buf.data = simGetVisionSensorDepthBuffer(handle);
+  buf.time = time;
+  return buf.data;
+}
+
+void VisionSensorManager::clear() {
+  MutexBinder b(m_m);
+  for(std::map<int, Cache>::iterator it = m_caches.begin();it != m_caches.end();++it) {
+    invalidate(it->first);
+  }
+  m_caches.clear();
+  m_fetches = 0;
+  m_hits = 0;
+}
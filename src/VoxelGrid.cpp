@@ -0,0 +1,78 @@
+#include "VoxelGrid.h"
+#include <string.h>
+#include <math.h>
+
+void VoxelGrid::configure(const int maxPoints, const float size)
+{
+  m_size = size;
+  if (size <= 0) {
+    m_voxels.clear();
+    m_table.clear();
+    m_mask = 0;
+    return;
+  }
+  // Load factor below 0.5 keeps the linear probing short.
+  uint32_t tableSize = 1;
+  while(tableSize < (uint32_t)maxPoints * 2) {
+    tableSize <<= 1;
+  }
+  m_voxels.resize(maxPoints > 0 ? maxPoints : 1);
+  m_table.resize(tableSize);
+  m_mask = tableSize - 1;
+}
+
+int VoxelGrid::filter(const float* points, const int count, float* out)
+{
+  if (m_size <= 0) {
+    if (out != points) {
+      memcpy(out, points, count * 4 * sizeof(float));
+    }
+    return count;
+  }
+  memset(&m_table[0], 0xFF, m_table.size() * sizeof(int32_t));
+  const float inverse = 1.0f / m_size;
+  int voxels = 0;
+  for(int i = 0;i < count;i++) {
+    const float* p = points + i * 4;
+    int32_t key[3];
+    for(int k = 0;k < 3;k++) {
+      key[k] = (int32_t)floorf(p[k] * inverse);
+    }
+    uint32_t h = ((uint32_t)key[0] * 73856093u ^ (uint32_t)key[1] * 19349663u ^ (uint32_t)key[2] * 83492791u) & m_mask;
+    while(m_table[h] >= 0) {
+      const Voxel& v = m_voxels[m_table[h]];
+      if (v.key[0] == key[0] && v.key[1] == key[1] && v.key[2] == key[2]) {
+	break;
+      }
+      h = (h + 1) & m_mask;
+    }
+    if (m_table[h] < 0) {
+      m_table[h] = voxels;
+      Voxel& v = m_voxels[voxels++];
+      memcpy(v.key, key, sizeof(key));
+      v.sum[0] = v.sum[1] = v.sum[2] = 0;
+      v.colour[0] = v.colour[1] = v.colour[2] = 0;
+      v.count = 0;
+    }
+    Voxel& v = m_voxels[m_table[h]];
+    uint32_t rgb;
+    memcpy(&rgb, p + 3, 4);
+    v.sum[0] += p[0];
+    v.sum[1] += p[1];
+    v.sum[2] += p[2];
+    v.colour[0] += (rgb >> 16) & 0xFF;
+    v.colour[1] += (rgb >> 8) & 0xFF;
+    v.colour[2] += rgb & 0xFF;
+    v.count++;
+  }
+  for(int i = 0;i < voxels;i++) {
+    const Voxel& v = m_voxels[i];
+    float* p = out + i * 4;
+    p[0] = v.sum[0] / v.count;
+    p[1] = v.sum[1] / v.count;
+    p[2] = v.sum[2] / v.count;
+    uint32_t rgb = ((v.colour[0] / v.count) << 16) | ((v.colour[1] / v.count) << 8) | (v.colour[2] / v.count);
+    memcpy(p + 3, &rgb, 4);
+  }
+  return voxels;
+}
@@ -0,0 +1,95 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool() : m_started(m_m), m_finished(m_m), m_task(NULL), m_count(0), m_next(0), m_pending(0),
+			   m_generation(0), m_running(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+  stop();
+}
+
+void WorkerPool::start(const int threads)
+{
+  stop();
+  m_running = true;
+  for(int i = 0;i < threads;i++) {
+    Worker* w = new Worker(this);
+    m_workers.push_back(w);
+    w->activate();
+  }
+}
+
+void WorkerPool::stop()
+{
+  if (m_workers.empty()) {
+    m_running = false;
+    return;
+  }
+  m_m.lock();
+  m_running = false;
+  m_started.broadcast();
+  m_m.unlock();
+  for(size_t i = 0;i < m_workers.size();i++) {
+    m_workers[i]->wait();
+    delete m_workers[i];
+  }
+  m_workers.clear();
+}
+
+/**
+ * Take indices until none is left. Called with m_m locked.
+ */
+void WorkerPool::executeAll()
+{
+  while(m_next < m_count) {
+    int index = m_next++;
+    ParallelTask* task = m_task;
+    m_m.unlock();
+    task->execute(index);
+    m_m.lock();
+    if (--m_pending == 0) {
+      m_finished.broadcast();
+    }
+  }
+}
+
+void WorkerPool::work()
+{
+  uint32_t generation = 0;
+  m_m.lock();
+  while(true) {
+    while(m_running && generation == m_generation) {
+      m_started.wait();
+    }
+    if (!m_running) {
+      break;
+    }
+    generation = m_generation;
+    executeAll();
+  }
+  m_m.unlock();
+}
+
+void WorkerPool::run(ParallelTask& task, const int count)
+{
+  if (m_workers.empty() || count <= 1) {
+    for(int i = 0;i < count;i++) {
+      task.execute(i);
+    }
+    return;
+  }
+  MutexBinder b(m_m);
+  m_task = &task;
+  m_count = count;
+  m_next = 0;
+  m_pending = count;
+  m_generation++;
+  m_started.broadcast();
+  executeAll();
+  while(m_pending > 0) {
+    m_finished.wait();
+  }
+  m_task = NULL;
+}
@@ -0,0 +1,373 @@
+/**
+ * Drives every sensor and robot RTC through onActivated and past the
+ * warm-up of its AllocationCheck against a fake V-REP API, and fails if
+ * any tick after the warm-up allocated.
+ *
+ * The sources are compiled into this program with RTC_ALLOCATION_CHECK,
+ * so allocations which OpenRTM makes on the ticking thread inside the
+ * checked part of onExecute count too. The port writes are outside of it,
+ * the hand-off to the encode and filter workers inside. The fake simulator
+ * allocates its buffers with malloc like V-REP, which is not counted.
+ */
+#include <rtm/Manager.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "v_repLib.h"
+#include "AllocationCheck.h"
+#include "ImageEncoder.h"
+#include "VisionSensorManager.h"
+#include "RangeRTC.h"
+#include "CameraRTC.h"
+#include "CameraArrayRTC.h"
+#include "StereoCameraRTC.h"
+#include "AccelerometerRTC.h"
+#include "GyroRTC.h"
+#include "DepthRTC.h"
+#include "RobotRTC.h"
+#include "RobotFleetRTC.h"
+#include "ObjectRTC.h"
+
+// Enough ticks for allocations which only happen every few dozen ticks,
+// like a new block of a std::deque.
+static const int TICKS = 200;
+static const float TIME_STEP = 0.05f;
+
+// Objects of the fake scene.
+static const int CAMERA = 10;
+static const int RIGHT_CAMERA = 11;
+static const int SECOND_CAMERA = 12;
+static const int JOINT = 20;  // JOINT to JOINT+JOINTS-1
+static const int JOINTS = 3;
+static const int ROBOT = 30;
+static const int RANGE = 31;
+static const int ACCELEROMETER = 32;
+static const int GYRO = 33;
+static const int OBJECT = 34;
+
+static const int SENSOR_WIDTH = 64;
+static const int SENSOR_HEIGHT = 48;
+
+// Tubes of the fake scene and the messages written to them every tick.
+static const int RANGE_TUBE = 1;
+static const int ACCELEROMETER_TUBE = 2;
+static const int GYRO_TUBE = 3;
+static const int RANGE_RAYS = 683;
+static const int RANGE_MESSAGES = 3;
+
+static float simulationTime = 0;
+static std::map<int, int> tubeMessages;
+
+static bool isVisionSensor(const int handle)
+{
+  return handle == CAMERA || handle == RIGHT_CAMERA || handle == SECOND_CAMERA;
+}
+
+static simFloat fakeGetSimulationTime() { return simulationTime; }
+static simFloat fakeGetSimulationTimeStep() { return TIME_STEP; }
+static simInt fakeReleaseBuffer(const simChar* buffer) { free((void*)buffer); return 1; }
+
+static simChar* fakeTubeRead(simInt tubeHandle, simInt* dataLength)
+{
+  if (tubeMessages[tubeHandle] <= 0) {
+    return NULL;
+  }
+  tubeMessages[tubeHandle]--;
+  const int floats = (tubeHandle == RANGE_TUBE) ? RANGE_RAYS * 3 : 3;
+  float* data = (float*)malloc(floats * sizeof(float));
+  for(int i = 0;i < floats;i += 3) {
+    const float angle = -2.0f + 4.0f * i / floats;
+    const float distance = 1.0f + 0.1f * sinf(simulationTime + i);
+    data[i] = distance * cosf(angle);
+    data[i + 1] = distance * sinf(angle);
+    data[i + 2] = 0;
+  }
+  *dataLength = floats * sizeof(float);
+  return (simChar*)data;
+}
+
+static simInt fakeTubeStatus(simInt tubeHandle, simInt* readPacketsCount, simInt* writePacketsCount)
+{
+  *readPacketsCount = tubeMessages[tubeHandle];
+  *writePacketsCount = 0;
+  return 1;
+}
+
+static simInt fakeGetVisionSensorResolution(simInt sensorHandle, simInt* resolution)
+{
+  if (!isVisionSensor(sensorHandle)) {
+    return -1;
+  }
+  resolution[0] = SENSOR_WIDTH;
+  resolution[1] = SENSOR_HEIGHT;
+  return 1;
+}
+
+static simFloat* fakeGetVisionSensorImage(simInt sensorHandle)
+{
+  const int size = SENSOR_WIDTH * SENSOR_HEIGHT * 3;
+  simFloat* image = (simFloat*)malloc(size * sizeof(simFloat));
+  for(int i = 0;i < size;i++) {
+    image[i] = (i % 256) / 255.0f;
+  }
+  return image;
+}
+
+static simUChar* fakeGetVisionSensorCharImage(simInt sensorHandle, simInt* resolutionX, simInt* resolutionY)
+{
+  const int size = SENSOR_WIDTH * SENSOR_HEIGHT * 3;
+  simUChar* image = (simUChar*)malloc(size);
+  for(int i = 0;i < size;i++) {
+    image[i] = (simUChar)i;
+  }
+  *resolutionX = SENSOR_WIDTH;
+  *resolutionY = SENSOR_HEIGHT;
+  return image;
+}
+
+static simFloat* fakeGetVisionSensorDepthBuffer(simInt sensorHandle)
+{
+  const int size = SENSOR_WIDTH * SENSOR_HEIGHT;
+  simFloat* depth = (simFloat*)malloc(size * sizeof(simFloat));
+  for(int i = 0;i < size;i++) {
+    // Some pixels on the far clipping plane, as without a hit.
+    depth[i] = (i % 17 == 0) ? 1.0f : 0.2f + 0.5f * (i % SENSOR_WIDTH) / SENSOR_WIDTH;
+  }
+  return depth;
+}
+
+static simInt fakeHandleVisionSensor(simInt sensorHandle, simFloat** auxValues, simInt** auxValuesCount)
+{
+  return isVisionSensor(sensorHandle) ? 0 : -1;
+}
+
+static simInt fakeGetExplicitHandling(simInt objectHandle) { return 0; }
+static simInt fakeSetExplicitHandling(simInt objectHandle, simInt explicitFlags) { return 1; }
+
+static simInt fakeGetObjectFloatParameter(simInt objectHandle, simInt parameterID, simFloat* parameter)
+{
+  switch(parameterID) {
+  case sim_visionfloatparam_near_clipping: *parameter = 0.01f; return 1;
+  case sim_visionfloatparam_far_clipping: *parameter = 10.0f; return 1;
+  case sim_visionfloatparam_perspective_angle: *parameter = 1.0f; return 1;
+  }
+  return 0;
+}
+
+static simInt fakeGetObjectIntParameter(simInt objectHandle, simInt parameterID, simInt* parameter)
+{
+  if (parameterID == sim_visionintparam_perspective_operation) {
+    *parameter = 1;
+    return 1;
+  }
+  return 0;
+}
+
+static simInt fakeGetObjectMatrix(simInt objectHandle, simInt relativeToObjectHandle, simFloat* matrix)
+{
+  // The right camera is 10 cm to the right, which is -x of a vision sensor.
+  const float pose[12] = {1, 0, 0, objectHandle == RIGHT_CAMERA ? -0.1f : 0.0f,
+			  0, 1, 0, 0,
+			  0, 0, 1, 0};
+  memcpy(matrix, pose, sizeof(pose));
+  return 1;
+}
+
+static simInt fakeGetObjectPosition(simInt objectHandle, simInt relativeToObjectHandle, simFloat* position)
+{
+  position[0] = simulationTime;
+  position[1] = 0;
+  position[2] = 0;
+  return 1;
+}
+
+static simInt fakeGetObjectOrientation(simInt objectHandle, simInt relativeToObjectHandle, simFloat* eulerAngles)
+{
+  eulerAngles[0] = eulerAngles[1] = 0;
+  eulerAngles[2] = simulationTime;
+  return 1;
+}
+
+static simInt fakeGetJointPosition(simInt objectHandle, simFloat* position)
+{
+  *position = simulationTime * (objectHandle - JOINT + 1);
+  return 1;
+}
+
+static simInt fakeJointGetForce(simInt jointHandle, simFloat* forceOrTorque)
+{
+  *forceOrTorque = 1.0f;
+  return 1;
+}
+
+static simInt fakeSetJointValue(simInt objectHandle, simFloat value) { return 1; }
+
+static void installFakeSimulator()
+{
+  simGetSimulationTime = (ptrSimGetSimulationTime)fakeGetSimulationTime;
+  simGetSimulationTimeStep = (ptrSimGetSimulationTimeStep)fakeGetSimulationTimeStep;
+  simReleaseBuffer = (ptrSimReleaseBuffer)fakeReleaseBuffer;
+  simTubeRead = (ptrSimTubeRead)fakeTubeRead;
+  simTubeStatus = (ptrSimTubeStatus)fakeTubeStatus;
+  simGetVisionSensorResolution = (ptrSimGetVisionSensorResolution)fakeGetVisionSensorResolution;
+  simGetVisionSensorImage = (ptrSimGetVisionSensorImage)fakeGetVisionSensorImage;
+  simGetVisionSensorCharImage = (ptrSimGetVisionSensorCharImage)fakeGetVisionSensorCharImage;
+  simGetVisionSensorDepthBuffer = (ptrSimGetVisionSensorDepthBuffer)fakeGetVisionSensorDepthBuffer;
+  simHandleVisionSensor = (ptrSimHandleVisionSensor)fakeHandleVisionSensor;
+  simGetExplicitHandling = (ptrSimGetExplicitHandling)fakeGetExplicitHandling;
+  simSetExplicitHandling = (ptrSimSetExplicitHandling)fakeSetExplicitHandling;
+  simGetObjectFloatParameter = (ptrSimGetObjectFloatParameter)fakeGetObjectFloatParameter;
+  simGetObjectIntParameter = (ptrSimGetObjectIntParameter)fakeGetObjectIntParameter;
+  simGetObjectMatrix = (ptrSimGetObjectMatrix)fakeGetObjectMatrix;
+  simGetObjectPosition = (ptrSimGetObjectPosition)fakeGetObjectPosition;
+  simGetObjectOrientation = (ptrSimGetObjectOrientation)fakeGetObjectOrientation;
+  simGetJointPosition = (ptrSimGetJointPosition)fakeGetJointPosition;
+  simJointGetForce = (ptrSimJointGetForce)fakeJointGetForce;
+  simSetJointTargetPosition = (ptrSimSetJointTargetPosition)fakeSetJointValue;
+  simSetJointTargetVelocity = (ptrSimSetJointTargetVelocity)fakeSetJointValue;
+  simSetJointForce = (ptrSimSetJointForce)fakeSetJointValue;
+}
+
+/**
+ * createComponent arguments as RTCHelper builds them for the fake scene,
+ * followed by the configuration under test.
+ */
+static std::vector<std::string> componentArguments()
+{
+  std::vector<std::string> args;
+  std::ostringstream camera;
+  camera << "conf.__innerparam.objectHandle=" << CAMERA;
+  std::ostringstream cameras;
+  cameras << "conf.__innerparam.objectNames=Camera,Camera2&conf.__innerparam.objectHandles="
+	  << CAMERA << "," << SECOND_CAMERA;
+  std::ostringstream stereo;
+  stereo << "conf.__innerparam.objectNames=Left,Right&conf.__innerparam.objectHandles="
+	 << CAMERA << "," << RIGHT_CAMERA;
+  std::ostringstream range;
+  range << "conf.__innerparam.objectHandle=" << RANGE << "&conf.__innerparam.tubeHandle=" << RANGE_TUBE
+	<< "&conf.__innerparam.bufSize=4096";
+  std::ostringstream accelerometer;
+  accelerometer << "conf.__innerparam.objectHandle=" << ACCELEROMETER
+		<< "&conf.__innerparam.tubeHandle=" << ACCELEROMETER_TUBE << "&conf.__innerparam.bufSize=4096";
+  std::ostringstream gyro;
+  gyro << "conf.__innerparam.objectHandle=" << GYRO
+       << "&conf.__innerparam.tubeHandle=" << GYRO_TUBE << "&conf.__innerparam.bufSize=4096";
+  std::ostringstream object;
+  object << "conf.__innerparam.objectHandle=" << OBJECT;
+  std::ostringstream names, handles;
+  for(int i = 0;i < JOINTS;i++) {
+    names << (i ? "," : "") << "joint" << i;
+    handles << (i ? "," : "") << JOINT + i;
+  }
+  std::ostringstream robot;
+  robot << "conf.default.controlledJointNames=" << names.str() << "&conf.default.observedJointNames=" << names.str()
+	<< "&conf.__innerparam.objectHandle=" << ROBOT << "&conf.__innerparam.allNames=" << names.str()
+	<< "&conf.__innerparam.allHandles=" << handles.str();
+  std::ostringstream fleet;
+  fleet << "conf.__innerparam.robotNames=robot0,robot1&conf.__innerparam.jointCounts=2," << JOINTS - 2
+	<< "&conf.__innerparam.allHandles=" << handles.str();
+
+  args.push_back("CameraRTC?" + camera.str());
+  args.push_back("CameraRTC?" + camera.str() + "&conf.default.imageSource=byte&conf.default.pixelFormat=nv12");
+  args.push_back("CameraRTC?" + camera.str() + "&conf.default.binning=2&conf.default.roi=8,8,32,24"
+		 "&conf.default.pyramidLevels=2&conf.default.renderMode=onDemand");
+  // The frames go to the ImageEncodeWorker, only the hand-off is on the ticking thread.
+  if (isImageFormatSupported("jpeg")) {
+    args.push_back("CameraRTC?" + camera.str() + "&conf.default.format=jpeg");
+  }
+  if (isImageFormatSupported("png")) {
+    args.push_back("CameraRTC?" + camera.str() + "&conf.default.format=png&conf.default.pixelFormat=mono8");
+  }
+  args.push_back("CameraArrayRTC?" + cameras.str());
+  args.push_back("CameraArrayRTC?" + cameras.str() + "&conf.default.layout=batch&conf.default.imageSource=byte");
+  args.push_back("StereoCameraRTC?" + stereo.str());
+  args.push_back("StereoCameraRTC?" + stereo.str() + "&conf.default.rectify=off&conf.default.imageSource=byte");
+  args.push_back("DepthRTC?" + camera.str());
+  args.push_back("DepthRTC?" + camera.str() + "&conf.default.outputFormat=packed&conf.default.workerThreads=2");
+  args.push_back("DepthRTC?" + camera.str() + "&conf.default.outputFormat=packed&conf.default.voxelSize=0.05"
+		 "&conf.default.cullFarPlane=on&conf.default.frame=world");
+  args.push_back("DepthRTC?" + camera.str() + "&conf.default.outputFormat=depth16");
+  args.push_back("DepthRTC?" + camera.str() + "&conf.default.outputFormat=depth32f");
+  args.push_back("DepthRTC?" + camera.str() + "&conf.default.outputFormat=octree");
+  args.push_back("RangeRTC?" + range.str());
+  args.push_back("RangeRTC?" + range.str() + "&conf.default.drainPolicy=all");
+  args.push_back("RangeRTC?" + range.str() + "&conf.default.drainPolicy=average");
+  args.push_back("AccelerometerRTC?" + accelerometer.str());
+  args.push_back("GyroRTC?" + gyro.str());
+  args.push_back("ObjectRTC?" + object.str() + "&conf.default.publishMode=onChange");
+  args.push_back("RobotRTC?" + robot.str());
+  args.push_back("RobotFleetRTC?" + fleet.str());
+  return args;
+}
+
+int main(int argc, char** argv)
+{
+  installFakeSimulator();
+  // Nothing is registered to a name server, the components are called directly.
+  char* managerArgs[] = {argv[0], (char*)"-o", (char*)"naming.enable:NO", (char*)"-o", (char*)"logger.enable:NO"};
+  RTC::Manager* manager = RTC::Manager::init(5, managerArgs);
+  manager->activateManager();
+  RangeRTCInit(manager);
+  CameraRTCInit(manager);
+  CameraArrayRTCInit(manager);
+  StereoCameraRTCInit(manager);
+  AccelerometerRTCInit(manager);
+  GyroRTCInit(manager);
+  DepthRTCInit(manager);
+  RobotRTCInit(manager);
+  RobotFleetRTCInit(manager);
+  ObjectRTCInit(manager);
+
+  int failures = 0;
+  std::vector<std::string> args = componentArguments();
+  for(size_t k = 0;k < args.size();k++) {
+    // No execution context thread, the ticks below are the only ones.
+    std::string arg = args[k] + "&exec_cxt.periodic.type=SynchExtTriggerEC";
+    std::cout << " - " << args[k] << std::endl;
+    RTC::RTObject_impl* rtc = manager->createComponent(arg.c_str());
+    if (rtc == NULL) {
+      std::cout << " -- createComponent FAILED" << std::endl;
+      failures++;
+      continue;
+    }
+    tubeMessages.clear();
+    simulationTime = 0;
+    if (rtc->on_activated(0) != RTC::RTC_OK) {
+      std::cout << " -- onActivated FAILED" << std::endl;
+      failures++;
+      rtc->exit();
+      continue;
+    }
+    const unsigned long before = AllocationCheck::totalViolations();
+    for(int tick = 0;tick < TICKS;tick++) {
+      simulationTime += TIME_STEP;
+      tubeMessages[RANGE_TUBE] = RANGE_MESSAGES;
+      tubeMessages[ACCELEROMETER_TUBE] = 1;
+      tubeMessages[GYRO_TUBE] = 1;
+      // As tickRTCs does on the V-REP main thread.
+      visionSensors.renderRequested(simulationTime);
+      rtc->on_execute(0);
+    }
+    const unsigned long violations = AllocationCheck::totalViolations() - before;
+    rtc->on_deactivated(0);
+    rtc->exit();
+    std::cout << " -- " << violations << " ticks allocated after the warm-up"
+	      << (violations > 0 ? " FAILED" : "") << std::endl;
+    if (violations > 0) {
+      failures++;
+    }
+  }
+
+  manager->shutdown();
+  if (failures > 0) {
+    std::cout << " - " << failures << " of " << args.size() << " components failed." << std::endl;
+    return 1;
+  }
+  std::cout << " - No component allocated after the warm-up." << std::endl;
+  return 0;
+}
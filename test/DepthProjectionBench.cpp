@@ -0,0 +1,94 @@
+/**
+ * Times the back-projection of a 640x480 depth buffer: the per pixel
+ * sin/cos loop which DepthRTC used before DepthProjection, the ray table
+ * in scalar code and the SSE kernel.
+ *
+ * The old loop took the depth buffer values as they are and had y to the
+ * right. DepthProjection linearizes them with the clipping planes and has
+ * y to the left, so the comparison maps the old output the same way.
+ */
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "DepthProjection.h"
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int FRAMES = 100;
+static const double ANGULAR_RESOLUTION = 0.002;
+static const float NEAR_CLIPPING = 0.05f;
+static const float FAR_CLIPPING = 30.0f;
+
+static void projectOld(const float* pBuffer, float* points, const int width, const int height,
+		       const double angularResolution)
+{
+  for (int i = 0;i < height;i++) {
+    for (int j = 0;j < width;j++) {
+      int index = i*width + j;
+      double vertical_angle = (i - height/2) * angularResolution;
+      double horizontal_angle = (j - width/2) * angularResolution;
+      float depth = pBuffer[index];
+      double sinV = sin(vertical_angle);
+      double cosV = cos(vertical_angle);
+      double sinH = sin(horizontal_angle);
+      double cosH = cos(horizontal_angle);
+      points[index * 4 + 0] = depth * cosV * cosH;
+      points[index * 4 + 1] = depth * cosV * sinH;
+      points[index * 4 + 2] = depth * sinV;
+    }
+  }
+}
+
+static double millisecondsPerFrame(const clock_t begin)
+{
+  return (clock() - begin) * 1000.0 / CLOCKS_PER_SEC / FRAMES;
+}
+
+int main(int argc, char** argv)
+{
+  const int pixels = WIDTH * HEIGHT;
+  std::vector<float> depth(pixels);
+  srand(1);
+  for(int i = 0;i < pixels;i++) {
+    depth[i] = (rand() + 1.0f) / ((float)RAND_MAX + 1.0f);
+  }
+  DepthProjection projection;
+  projection.configureSpherical(WIDTH, HEIGHT, ANGULAR_RESOLUTION, NEAR_CLIPPING, FAR_CLIPPING);
+  std::vector<float> oldPoints(pixels * 4), scalarPoints(pixels * 4), points(pixels * 4);
+
+  clock_t begin = clock();
+  for(int k = 0;k < FRAMES;k++) {
+    projectOld(&depth[0], &oldPoints[0], WIDTH, HEIGHT, ANGULAR_RESOLUTION);
+  }
+  const double oldTime = millisecondsPerFrame(begin);
+  begin = clock();
+  for(int k = 0;k < FRAMES;k++) {
+    projection.projectScalar(&depth[0], &scalarPoints[0], 0, pixels);
+  }
+  const double scalarTime = millisecondsPerFrame(begin);
+  begin = clock();
+  for(int k = 0;k < FRAMES;k++) {
+    projection.project(&depth[0], &points[0], 0, pixels);
+  }
+  const double kernelTime = millisecondsPerFrame(begin);
+
+  // Same rays: old point / raw value * metric depth, with y mirrored.
+  double maxError = 0;
+  for(int i = 0;i < pixels;i++) {
+    const float scale = projection.depth(depth[i]) / depth[i];
+    const float expected[3] = {oldPoints[i * 4] * scale, -oldPoints[i * 4 + 1] * scale, oldPoints[i * 4 + 2] * scale};
+    for(int k = 0;k < 3;k++) {
+      const double error = fabs(points[i * 4 + k] - expected[k]) / FAR_CLIPPING;
+      maxError = error > maxError ? error : maxError;
+    }
+  }
+
+  std::cout << " - " << WIDTH << "x" << HEIGHT << " depth buffer, " << FRAMES << " frames" << std::endl;
+  std::cout << " -- sin/cos loop:    " << oldTime << " ms/frame" << std::endl;
+  std::cout << " -- ray table:       " << scalarTime << " ms/frame" << std::endl;
+  std::cout << " -- ray table (SSE): " << kernelTime << " ms/frame" << std::endl;
+  std::cout << " -- largest difference to the mapped old points: " << maxError << " of the far clipping distance" << std::endl;
+  return maxError < 1e-5 ? 0 : 1;
+}
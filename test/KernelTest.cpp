@@ -0,0 +1,487 @@
+/**
+ * Compares the SIMD kernels with their scalar references, and the image
+ * conversions with the per pixel loop they replaced, on random input.
+ * Image sizes are not multiples of the vector width, so the tails are
+ * covered too. Exits with 1 if any kernel differs.
+ */
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "ImageConversion.h"
+#include "DepthProjection.h"
+#include "RangeScan.h"
+#include "OctreeCodec.h"
+#include "VoxelGrid.h"
+#include "PackedPointCloud.h"
+
+static int failures = 0;
+
+static void check(const char* name, const bool ok)
+{
+  std::cout << " -- " << name << (ok ? " ok" : " FAILED") << std::endl;
+  if (!ok) {
+    failures++;
+  }
+}
+
+static float randomFloat(const float lower, const float upper)
+{
+  return lower + (upper - lower) * (rand() / (float)RAND_MAX);
+}
+
+static bool closeTo(const std::vector<float>& a, const std::vector<float>& b, const float tolerance)
+{
+  for(size_t i = 0;i < a.size();i++) {
+    if (fabs(a[i] - b[i]) > tolerance * (1.0f + fabs(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * The per pixel loop of CameraRTC before ImageConverter, for 0.0-1.0 values.
+ */
+static void baselineConvert(const float* pBuffer, uint8_t* pixels, const int width, const int height)
+{
+  for (int i = 0;i < height;i++) {
+    for (int j = 0;j < width;j++) {
+      int index = i*width*3 + j*3;
+      int buffer_index = (width * (height-i-1)) * 3 + j*3;
+      pixels[buffer_index + 0] = static_cast<unsigned char>(pBuffer[index+2] * 255);
+      pixels[buffer_index + 1] = static_cast<unsigned char>(pBuffer[index+1] * 255);
+      pixels[buffer_index + 2] = static_cast<unsigned char>(pBuffer[index+0] * 255);
+    }
+  }
+}
+
+/**
+ * The same loop for byte images.
+ */
+static void baselineConvert(const uint8_t* pBuffer, uint8_t* pixels, const int width, const int height)
+{
+  for (int i = 0;i < height;i++) {
+    for (int j = 0;j < width;j++) {
+      int index = i*width*3 + j*3;
+      int buffer_index = (width * (height-i-1)) * 3 + j*3;
+      pixels[buffer_index + 0] = pBuffer[index+2];
+      pixels[buffer_index + 1] = pBuffer[index+1];
+      pixels[buffer_index + 2] = pBuffer[index+0];
+    }
+  }
+}
+
+/**
+ * Rounded mean of every binning x binning block of a region of a BGR image.
+ */
+static void binRegion(const uint8_t* bgr, const int width, const ImageRegion& region, const int binning,
+		      uint8_t* dst, const int dstStride)
+{
+  const int blockPixels = binning * binning;
+  for(int r = 0;r < region.height / binning;r++) {
+    for(int c = 0;c < region.width / binning;c++) {
+      for(int ch = 0;ch < 3;ch++) {
+	int sum = 0;
+	for(int dy = 0;dy < binning;dy++) {
+	  for(int dx = 0;dx < binning;dx++) {
+	    sum += bgr[((region.y + r * binning + dy) * width + region.x + c * binning + dx) * 3 + ch];
+	  }
+	}
+	dst[r * dstStride + c * 3 + ch] = (uint8_t)((sum + blockPixels / 2) / blockPixels);
+      }
+    }
+  }
+}
+
+/**
+ * Convert with ImageConverter and with the baseline loop followed by the
+ * naive crop and binning. The output rows are padded to check dstStride.
+ */
+template<class T>
+static bool matchesBaseline(const std::vector<T>& src, const std::vector<T>& baselineSrc, const int width, const int height,
+			    const ImageRegion& region, const int binning)
+{
+  ImageConverter converter;
+  if (!converter.configure(width, height, region, binning)) {
+    return false;
+  }
+  const int padding = 7;
+  const int stride = converter.width() * 3 + padding;
+  std::vector<uint8_t> converted(stride * converter.height(), 0xA5), expected(stride * converter.height(), 0xA5);
+  converter.convert(&src[0], &converted[0], stride);
+  std::vector<uint8_t> bgr(width * height * 3);
+  baselineConvert(&baselineSrc[0], &bgr[0], width, height);
+  binRegion(&bgr[0], width, converter.region(), binning, &expected[0], stride);
+  return converted == expected;
+}
+
+static void testImageConverter(const int width, const int height)
+{
+  const int size = width * height * 3;
+  // Values outside 0.0-1.0 exercise the clamping, the baseline loop gets
+  // them clamped as it only handled in-range values.
+  std::vector<float> floatImage(size), clampedImage(size);
+  std::vector<uint8_t> byteImage(size);
+  for(int i = 0;i < size;i++) {
+    floatImage[i] = randomFloat(-0.1f, 1.1f);
+    clampedImage[i] = floatImage[i] < 0.0f ? 0.0f : (floatImage[i] > 1.0f ? 1.0f : floatImage[i]);
+    byteImage[i] = (uint8_t)rand();
+  }
+  const ImageRegion regions[] = {{0, 0, 0, 0}, {5, 3, 21, 13}, {1, 2, width - 1, 0}};
+  const char* regionNames[] = {"full", "roi", "odd width"};
+  const int binnings[] = {1, 2, 4};
+  for(int k = 0;k < 3;k++) {
+    for(int b = 0;b < 3;b++) {
+      std::ostringstream name;
+      name << width << "x" << height << " " << regionNames[k] << " binning " << binnings[b];
+      check(("ImageConverter float " + name.str()).c_str(),
+	    matchesBaseline(floatImage, clampedImage, width, height, regions[k], binnings[b]));
+      check(("ImageConverter byte " + name.str()).c_str(),
+	    matchesBaseline(byteImage, byteImage, width, height, regions[k], binnings[b]));
+    }
+  }
+}
+
+static void testImagePyramid(const int width, const int height, const int levels)
+{
+  std::vector<uint8_t> base(width * height * 3);
+  for(size_t i = 0;i < base.size();i++) {
+    base[i] = (uint8_t)rand();
+  }
+  ImagePyramid pyramid;
+  bool ok = pyramid.configure(width, height, levels);
+  if (ok) {
+    pyramid.build(&base[0], levels);
+  }
+  std::vector<uint8_t> previous(base), expected;
+  int w = width;
+  for(int k = 1;ok && k <= levels;k++) {
+    // Only the even part of an odd sized level is used.
+    const ImageRegion region = {0, 0, w / 2 * 2, pyramid.height(k) * 2};
+    expected.assign(pyramid.width(k) * pyramid.height(k) * 3, 0);
+    binRegion(&previous[0], w, region, 2, &expected[0], pyramid.width(k) * 3);
+    ok = std::equal(expected.begin(), expected.end(), pyramid.level(k));
+    previous.swap(expected);
+    w = pyramid.width(k);
+  }
+  std::ostringstream name;
+  name << "ImagePyramid " << width << "x" << height << " " << levels << " levels";
+  check(name.str().c_str(), ok);
+}
+
+static void testPixelFormats(const int width, const int height)
+{
+  std::vector<uint8_t> bgr(width * height * 3);
+  for(size_t i = 0;i < bgr.size();i++) {
+    bgr[i] = (uint8_t)rand();
+  }
+  const char* names[] = {"bgr8", "mono8", "nv12", "rgb565"};
+  for(int k = 0;k < 4;k++) {
+    const int format = parsePixelFormat(names[k]);
+    const int formatSize = pixelFormatSize(format, width, height);
+    std::vector<uint8_t> simdFormat(formatSize), scalarFormat(formatSize);
+    convertBGRImage(&bgr[0], width, height, format, &simdFormat[0]);
+    convertBGRImageScalar(&bgr[0], width, height, format, &scalarFormat[0]);
+    std::string name = std::string("convertBGRImage ") + names[k];
+    check(name.c_str(), simdFormat == scalarFormat);
+  }
+}
+
+static void testDepthProjection(DepthProjection& projection, const char* name)
+{
+  const int pixels = projection.width() * projection.height();
+  std::vector<float> depth(pixels);
+  for(int i = 0;i < pixels;i++) {
+    depth[i] = randomFloat(0.0f, 1.0f);
+  }
+  std::vector<float> simd(pixels * 4), scalar(pixels * 4);
+  // An odd begin makes the SIMD loop start unaligned.
+  projection.project(&depth[0], &simd[0], 3, pixels);
+  projection.projectScalar(&depth[0], &scalar[0], 3, pixels);
+  simd.erase(simd.begin(), simd.begin() + 12);
+  scalar.erase(scalar.begin(), scalar.begin() + 12);
+  check(name, closeTo(simd, scalar, 1e-6f));
+}
+
+static void testDepthImage16()
+{
+  // 100 m far plane, so part of the range is beyond 65.535 m.
+  const int width = 83, height = 7;
+  const float near = 0.05f, far = 100.0f;
+  DepthProjection projection;
+  projection.configurePinhole(width, height, 1.0f, near, far);
+  const int pixels = width * height;
+  const float limit = (65.535f - near) / (far - near);
+  std::vector<float> depth(pixels);
+  for(int i = 0;i < pixels;i++) {
+    switch(i % 5) {
+    case 0: depth[i] = 1.0f; break;                                 // no hit
+    case 1: depth[i] = randomFloat(-0.01f, 0.0f); break;            // negative
+    case 2: depth[i] = randomFloat(limit - 1e-5f, limit + 1e-5f); break;
+    default: depth[i] = randomFloat(0.0f, 1.0f); break;
+    }
+  }
+  std::vector<uint16_t> simd(pixels), scalar(pixels);
+  projection.depthImage16(&depth[0], &simd[0]);
+  projection.depthImage16Scalar(&depth[0], &scalar[0]);
+  check("DepthProjection::depthImage16", simd == scalar);
+
+  // depthImage16 flips the rows, the checked row of depth is the bottom one.
+  const float row[8] = {1.0f, -0.01f, 0.7f, limit + 1e-4f, 0.0f, 0.5f, limit - 1e-4f, 2.0f};
+  const uint16_t expected[8] = {0, 0, 0, 0, 50, 50025, 65525, 0};
+  for(int i = 0;i < 8;i++) {
+    depth[i] = row[i];
+    depth[width - 8 + i] = row[i];
+  }
+  projection.depthImage16(&depth[0], &simd[0]);
+  bool ok = true;
+  const uint16_t* last = &simd[(height - 1) * width];
+  for(int i = 0;i < 8;i++) {
+    if (last[i] != expected[i] || last[width - 8 + i] != expected[i]) {
+      ok = false;
+    }
+  }
+  check("DepthProjection::depthImage16 no hit, negative and beyond 65.535 m", ok);
+}
+
+/**
+ * count points of 4 floats in a box spanning negative and positive
+ * coordinates, with random colours.
+ */
+static std::vector<float> randomCloud(const int count)
+{
+  std::vector<float> points(count * 4);
+  for(int i = 0;i < count;i++) {
+    float* p = &points[i * 4];
+    p[0] = randomFloat(-1.0f, 2.0f);
+    p[1] = randomFloat(-0.2f, 0.3f);
+    p[2] = randomFloat(3.0f, 4.0f);
+    const uint32_t rgb = (rand() & 0xFF) << 16 | (rand() & 0xFF) << 8 | (rand() & 0xFF);
+    memcpy(p + 3, &rgb, 4);
+  }
+  return points;
+}
+
+struct ColourSum {
+  uint32_t count;
+  uint32_t sum[3];
+};
+
+static void addColour(ColourSum& c, const float* p)
+{
+  uint32_t rgb;
+  memcpy(&rgb, p + 3, 4);
+  c.sum[0] += (rgb >> 16) & 0xFF;
+  c.sum[1] += (rgb >> 8) & 0xFF;
+  c.sum[2] += rgb & 0xFF;
+  c.count++;
+}
+
+/**
+ * Leaf cell of a point in the octree of the header, as the encoder quantizes.
+ */
+static uint64_t octreeCell(const float* p, const OctreeCloudHeader& header)
+{
+  const uint32_t cells = 1u << header.depth;
+  uint64_t key = 0;
+  for(int k = 0;k < 3;k++) {
+    uint32_t c = (uint32_t)((p[k] - header.origin[k]) * (cells / header.size));
+    key |= (uint64_t)(c < cells ? c : cells - 1) << (21 * k);
+  }
+  return key;
+}
+
+static void testOctreeCodec(const int count, const float resolution)
+{
+  std::vector<float> points = randomCloud(count);
+  OctreeEncoder encoder;
+  std::vector<uint8_t> data;
+  encoder.configure(count, data);
+  OctreeCloudHeader header;
+  memset(&header, 0, sizeof(header));
+  encoder.encode(count > 0 ? &points[0] : NULL, count, resolution, header, data);
+
+  OctreeCloudHeader decodedHeader;
+  std::vector<float> decoded;
+  bool ok = decodeOctreeCloud(&data[0], data.size(), decodedHeader, decoded);
+  ok = ok && decoded.size() == decodedHeader.leaves * 4;
+  const float leaf = count > 0 ? decodedHeader.size / (1 << decodedHeader.depth) : 0;
+  ok = ok && leaf <= resolution;
+
+  // Naive reference: the occupied leaf cells with the colours of their points.
+  std::map<uint64_t, ColourSum> cells;
+  for(int i = 0;ok && i < count;i++) {
+    ColourSum empty = {0, {0, 0, 0}};
+    addColour(cells.insert(std::make_pair(octreeCell(&points[i * 4], decodedHeader), empty)).first->second, &points[i * 4]);
+  }
+  ok = ok && cells.size() == decodedHeader.leaves;
+
+  // Every leaf is at an occupied cell with the RGB565 mean colour of its points.
+  std::map<uint64_t, const float*> centres;
+  for(uint32_t i = 0;ok && i < decodedHeader.leaves;i++) {
+    const float* p = &decoded[i * 4];
+    std::map<uint64_t, ColourSum>::const_iterator it = cells.find(octreeCell(p, decodedHeader));
+    if (it == cells.end()) {
+      ok = false;
+      break;
+    }
+    const ColourSum& c = it->second;
+    const uint32_t r = (c.sum[0] / c.count) >> 3, g = (c.sum[1] / c.count) >> 2, b = (c.sum[2] / c.count) >> 3;
+    const uint32_t expected = ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+    uint32_t rgb;
+    memcpy(&rgb, p + 3, 4);
+    ok = (rgb == expected);
+    centres[it->first] = p;
+  }
+  ok = ok && centres.size() == cells.size();
+
+  // Every point is within half a leaf diagonal of its leaf centre.
+  const float maxError = 0.5f * leaf * sqrtf(3.0f) * 1.0001f;
+  for(int i = 0;ok && i < count;i++) {
+    const float* p = &points[i * 4];
+    const float* c = centres[octreeCell(p, decodedHeader)];
+    const float dx = p[0] - c[0], dy = p[1] - c[1], dz = p[2] - c[2];
+    ok = sqrtf(dx * dx + dy * dy + dz * dz) <= maxError;
+  }
+  std::ostringstream name;
+  name << "OctreeEncoder/decodeOctreeCloud " << count << " points, resolution " << resolution;
+  check(name.str().c_str(), ok);
+}
+
+static void testVoxelGrid(const int count, const float size)
+{
+  std::vector<float> points = randomCloud(count);
+  std::vector<float> filtered(points);
+  VoxelGrid grid;
+  grid.configure(count, size);
+  // In place, as PointCloudFilterWorker filters.
+  const int voxels = grid.filter(&filtered[0], count, &filtered[0]);
+
+  // Naive reference: the points of every voxel in a std::map.
+  struct Centroid {
+    double sum[3];
+    ColourSum colour;
+  };
+  std::map<std::vector<int32_t>, Centroid> reference;
+  std::vector<int32_t> key(3);
+  for(int i = 0;i < count;i++) {
+    const float* p = &points[i * 4];
+    for(int k = 0;k < 3;k++) {
+      key[k] = (int32_t)floorf(p[k] * (1.0f / size));
+    }
+    Centroid empty = {{0, 0, 0}, {0, {0, 0, 0}}};
+    Centroid& c = reference.insert(std::make_pair(key, empty)).first->second;
+    for(int k = 0;k < 3;k++) {
+      c.sum[k] += p[k];
+    }
+    addColour(c.colour, p);
+  }
+  bool ok = (voxels == (int)reference.size());
+  int matched = 0;
+  for(int i = 0;ok && i < voxels;i++) {
+    const float* p = &filtered[i * 4];
+    // The centroid lies in its voxel.
+    for(int k = 0;k < 3;k++) {
+      key[k] = (int32_t)floorf(p[k] * (1.0f / size));
+    }
+    std::map<std::vector<int32_t>, Centroid>::const_iterator it = reference.find(key);
+    if (it == reference.end()) {
+      ok = false;
+      break;
+    }
+    const Centroid& c = it->second;
+    const uint32_t n = c.colour.count;
+    for(int k = 0;k < 3;k++) {
+      ok = ok && fabs(p[k] - c.sum[k] / n) <= 1e-5 * (1.0 + fabs(c.sum[k] / n));
+    }
+    uint32_t rgb;
+    memcpy(&rgb, p + 3, 4);
+    ok = ok && rgb == ((c.colour.sum[0] / n) << 16 | (c.colour.sum[1] / n) << 8 | (c.colour.sum[2] / n));
+    matched++;
+  }
+  ok = ok && matched == (int)reference.size();
+
+  grid.configure(count, 0);
+  std::vector<float> copy(points.size());
+  ok = ok && grid.filter(&points[0], count, &copy[0]) == count && copy == points;
+  std::ostringstream name;
+  name << "VoxelGrid " << count << " points, voxel " << size;
+  check(name.str().c_str(), ok);
+}
+
+static void testRangeScan(const int rays)
+{
+  std::vector<float> points(rays * 3);
+  for(int i = 0;i < rays;i++) {
+    const float angle = -2.0f + 4.0f * i / rays;
+    const float distance = (i % 7 == 0) ? 0.0f : randomFloat(0.1f, 40.0f);
+    points[i * 3 + 0] = distance * cosf(angle);
+    points[i * 3 + 1] = distance * sinf(angle);
+    points[i * 3 + 2] = 0.0f;
+  }
+  RangeScan scan;
+  scan.decode((const char*)&points[0], rays * 3 * sizeof(float));
+  std::vector<double> simd(rays), scalar(rays);
+  scan.distances(30.0, &simd[0]);
+  scan.distancesScalar(30.0, &scalar[0]);
+  // distances() computes in float, distancesScalar() in double.
+  bool ok = true;
+  for(int i = 0;i < rays;i++) {
+    if (fabs(simd[i] - scalar[i]) > 1e-5 * (1.0 + scalar[i])) {
+      ok = false;
+    }
+  }
+  check("RangeScan::distances", ok);
+}
+
+int main(int argc, char** argv)
+{
+  srand(1);
+  std::cout << " - Image conversion kernel: " << imageConversionKernel() << std::endl;
+  testImageConverter(640, 480);
+  testImageConverter(37, 22);
+  testImagePyramid(640, 480, 4);
+  testImagePyramid(37, 22, 3);
+  testPixelFormats(640, 480);
+  testPixelFormats(37, 22);
+
+  DepthProjection pinhole;
+  pinhole.configurePinhole(83, 61, 1.0f, 0.01f, 10.0f);
+  testDepthProjection(pinhole, "DepthProjection::project pinhole");
+  const float pose[12] = {0, 0, 1, 0.5f,
+			  1, 0, 0, -1.0f,
+			  0, 1, 0, 2.0f};
+  pinhole.setSensorPose(pose);
+  testDepthProjection(pinhole, "DepthProjection::project pinhole world frame");
+
+  DepthProjection spherical;
+  spherical.configureSpherical(91, 17, 0.01, 0.05f, 30.0f);
+  testDepthProjection(spherical, "DepthProjection::project spherical");
+
+  testDepthImage16();
+  testRangeScan(683);
+
+  testOctreeCodec(5000, 0.01f);
+  testOctreeCodec(1, 0.01f);
+  testOctreeCodec(0, 0.01f);
+  testVoxelGrid(5000, 0.05f);
+  testVoxelGrid(5000, 0.5f);
+  // Published by DepthRTC and read by other tools, the layout must not
+  // change. 80 bytes keep the points after it 16 byte aligned.
+  check("PackedPointCloudHeader layout",
+	sizeof(PackedPointCloudHeader) == 80 && offsetof(PackedPointCloudHeader, flags) == 16 &&
+	offsetof(PackedPointCloudHeader, nearClipping) == 20 && offsetof(PackedPointCloudHeader, pose) == 32);
+
+  if (failures > 0) {
+    std::cout << " - " << failures << " kernels differ from their reference." << std::endl;
+    return 1;
+  }
+  std::cout << " - All kernels match their reference." << std::endl;
+  return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * Times the packed point cloud path of DepthRTC (back-projection and
+ * colour of a 1280x960 frame in row blocks, 4 blocks per thread) on a
+ * WorkerPool with 0 to N helper threads, N from the command line
+ * (default 7). Also checks that the points do not depend on the threads.
+ * A speedup is only measured up to one thread per online CPU, the runs
+ * beyond are marked.
+ */
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "DepthProjection.h"
+#include "WorkerPool.h"
+
+static const int WIDTH = 1280;
+static const int HEIGHT = 960;
+static const int FRAMES = 50;
+
+class ProjectionTask : public ParallelTask {
+ public:
+  const DepthProjection* projection;
+  const float* depth;
+  const float* image;
+  float* points;
+  int rowsPerBlock;
+
+  virtual void execute(const int block) {
+    const int width = projection->width();
+    const int first = block * rowsPerBlock;
+    int last = first + rowsPerBlock;
+    if (last > projection->height()) {
+      last = projection->height();
+    }
+    projection->project(depth, points, first * width, last * width);
+    projection->colour(image, points, first * width, last * width);
+  }
+};
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int main(int argc, char** argv)
+{
+  const int maxThreads = argc > 1 ? atoi(argv[1]) : 7;
+  const int pixels = WIDTH * HEIGHT;
+  std::vector<float> depth(pixels), image(pixels * 3);
+  srand(1);
+  for(int i = 0;i < pixels;i++) {
+    depth[i] = rand() / (float)RAND_MAX;
+  }
+  for(int i = 0;i < pixels * 3;i++) {
+    image[i] = rand() / (float)RAND_MAX;
+  }
+  DepthProjection projection;
+  projection.configurePinhole(WIDTH, HEIGHT, 1.0f, 0.05f, 10.0f);
+  std::vector<float> reference(pixels * 4), points(pixels * 4);
+  projection.project(&depth[0], &reference[0], 0, pixels);
+  projection.colour(&image[0], &reference[0], 0, pixels);
+
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  std::cout << " - " << WIDTH << "x" << HEIGHT << " packed cloud, " << FRAMES << " frames, "
+	    << cpus << " CPUs online" << std::endl;
+  bool identical = true;
+  double serial = 0;
+  for(int threads = 0;threads <= maxThreads;threads++) {
+    WorkerPool pool;
+    pool.start(threads);
+    // Same split as DepthRTC.
+    const int blocks = threads > 0 ? (threads + 1) * 4 : 1;
+    ProjectionTask task;
+    task.projection = &projection;
+    task.depth = &depth[0];
+    task.image = &image[0];
+    task.points = &points[0];
+    task.rowsPerBlock = (HEIGHT + blocks - 1) / blocks;
+    memset(&points[0], 0, points.size() * sizeof(float));
+    pool.run(task, blocks);
+    const double begin = now();
+    for(int k = 0;k < FRAMES;k++) {
+      pool.run(task, blocks);
+    }
+    const double ms = (now() - begin) * 1000.0 / FRAMES;
+    pool.stop();
+    if (threads == 0) {
+      serial = ms;
+    }
+    if (memcmp(&points[0], &reference[0], points.size() * sizeof(float)) != 0) {
+      identical = false;
+    }
+    std::cout << " -- " << threads << " helper threads: " << ms << " ms/frame, speedup "
+	      << serial / ms << (threads + 1 > cpus ? " (more threads than CPUs)" : "") << std::endl;
+  }
+  std::cout << " -- points " << (identical ? "identical" : "DIFFER") << " for every thread count" << std::endl;
+  return identical ? 0 : 1;
+}